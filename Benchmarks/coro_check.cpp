@@ -0,0 +1,219 @@
+// Drives the coroutine layer (FSPX/src/intel/runtime/coro.hpp) on FReactor
+// without a board: FLoopbackPipe has the source/sink interface of FPipeGraph
+// that the awaitables use, over host memory, with `buffers` batches per
+// replica. Source coroutines co_await f_paced, f_get_batch and f_push, sink
+// coroutines f_pop and f_put_batch; every sink checks that it receives the
+// tuples of its source in order, up to the last batch.
+//
+// build: g++ -O2 -std=c++20 -pthread -I../FSPX/src/intel/ocl -I../FSPX/src/intel/runtime coro_check.cpp -o coro_check
+// usage: ./coro_check [replicas] [reactor_threads] [batches] [batch_size] [buffers]
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+#include "utils.hpp"
+#include "coro.hpp"
+
+#if !F_COROUTINES
+#error "coro_check needs C++20 coroutines (-std=c++20)"
+#endif
+
+
+// Source replica `rid` feeds sink replica `rid`
+template <typename T>
+struct FLoopbackPipe
+{
+    struct Channel
+    {
+        std::mutex mutex;
+        std::deque<T *> free;
+        std::deque<std::pair<T *, size_t>> full;
+        bool last = false;
+        size_t in_flight = 0;
+        size_t max_in_flight = 0;
+    };
+
+    std::vector<std::vector<T>> storage;
+    std::vector<Channel> channels;
+
+    FLoopbackPipe(const size_t replicas,
+                  const size_t buffers,
+                  const size_t batch_size)
+    : storage(replicas * buffers, std::vector<T>(batch_size))
+    , channels(replicas)
+    {
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            for (size_t b = 0; b < buffers; ++b) {
+                channels[rid].free.push_back(storage[rid * buffers + b].data());
+            }
+        }
+    }
+
+    bool source_poll(const size_t rid)
+    {
+        std::lock_guard<std::mutex> lock(channels[rid].mutex);
+        return !channels[rid].free.empty();
+    }
+
+    T * get_batch(const size_t rid)
+    {
+        Channel & c = channels[rid];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        T * batch = c.free.front();
+        c.free.pop_front();
+        c.max_in_flight = std::max(c.max_in_flight, ++c.in_flight);
+        return batch;
+    }
+
+    void push(T * batch,
+              const size_t n,
+              const size_t rid,
+              const bool last)
+    {
+        Channel & c = channels[rid];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        c.full.emplace_back(batch, n);
+        c.last = last;
+    }
+
+    bool sink_poll(const size_t rid,
+                   const size_t)
+    {
+        std::lock_guard<std::mutex> lock(channels[rid].mutex);
+        return !channels[rid].full.empty();
+    }
+
+    T * pop(const size_t rid,
+            const size_t,
+            size_t * received,
+            bool * last)
+    {
+        Channel & c = channels[rid];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        T * batch = c.full.front().first;
+        *received = c.full.front().second;
+        c.full.pop_front();
+        *last = c.last and c.full.empty();
+        return batch;
+    }
+
+    void put_batch(const size_t rid,
+                   T * batch)
+    {
+        Channel & c = channels[rid];
+        std::lock_guard<std::mutex> lock(c.mutex);
+        c.free.push_back(batch);
+        c.in_flight--;
+    }
+};
+
+
+FCoro source(FLoopbackPipe<uint64_t> & pipe,
+             FRatePacer & pacer,
+             const size_t rid,
+             const size_t batches,
+             const size_t batch_size)
+{
+    uint64_t next = 0;
+    for (size_t b = 0; b < batches; ++b) {
+        co_await f_paced(pacer, batch_size);
+        uint64_t * batch = co_await f_get_batch(pipe, rid);
+        for (size_t i = 0; i < batch_size; ++i) {
+            batch[i] = (uint64_t(rid) << 48) | next++;
+        }
+        co_await f_push(pipe, batch, batch_size, rid, b + 1 == batches);
+        co_await f_yield();
+    }
+}
+
+// what a sink received
+struct FSinkCheck
+{
+    size_t received = 0;
+    bool ok = true;
+};
+
+FCoro sink(FLoopbackPipe<uint64_t> & pipe,
+           const size_t rid,
+           const size_t batch_size,
+           FSinkCheck & check)
+{
+    uint64_t expected = 0;
+    bool last = false;
+    while (!last) {
+        FPopResult<uint64_t> r = co_await f_pop(pipe, rid, batch_size);
+        for (size_t i = 0; i < r.received; ++i) {
+            check.ok = check.ok and (r.batch[i] == ((uint64_t(rid) << 48) | expected++));
+        }
+        check.received += r.received;
+        last = r.last;
+        co_await f_put_batch(pipe, rid, r.batch);
+    }
+}
+
+
+int main(int argc, char * argv[])
+{
+    size_t replicas = 4;
+    size_t reactor_threads = 2;
+    size_t batches = 10000;
+    size_t batch_size = 256;
+    size_t buffers = 3;
+
+    argc--;
+    argv++;
+
+    int argi = 0;
+    if (argc > argi) replicas        = atoi(argv[argi++]);
+    if (argc > argi) reactor_threads = atoi(argv[argi++]);
+    if (argc > argi) batches         = atoi(argv[argi++]);
+    if (argc > argi) batch_size      = atoi(argv[argi++]);
+    if (argc > argi) buffers         = atoi(argv[argi++]);
+
+    FLoopbackPipe<uint64_t> pipe(replicas, buffers, batch_size);
+    FRateProfile rate_profile;  // max
+    std::vector<FRatePacer> pacers(replicas, FRatePacer(rate_profile, replicas, current_time_ns(), batch_size));
+
+    std::vector<FSinkCheck> checks(replicas);
+    std::vector<FCoro> streams;
+    for (size_t rid = 0; rid < replicas; ++rid) {
+        streams.push_back(source(pipe, pacers[rid], rid, batches, batch_size));
+    }
+    for (size_t rid = 0; rid < replicas; ++rid) {
+        streams.push_back(sink(pipe, rid, batch_size, checks[rid]));
+    }
+
+    const uint64_t start_ns = current_time_ns();
+    FReactor reactor(reactor_threads);
+    for (auto & s : streams) reactor.add(&s);
+    reactor.start();
+    reactor.join();
+    const double elapsed_s = (current_time_ns() - start_ns) * 1e-9;
+
+    bool all_ok = true;
+    for (size_t rid = 0; rid < replicas; ++rid) {
+        const bool rid_ok = checks[rid].ok and checks[rid].received == batches * batch_size
+                            and pipe.channels[rid].max_in_flight <= buffers
+                            and pipe.channels[rid].free.size() == buffers;
+        all_ok = all_ok and rid_ok;
+        std::cout << COUT_HEADER << "replica " + std::to_string(rid) + ": "
+                  << COUT_INTEGER << checks[rid].received << " tuples, "
+                  << pipe.channels[rid].max_in_flight << " batches in flight"
+                  << (rid_ok ? "" : " (WRONG)") << '\n';
+    }
+    std::cout << COUT_HEADER << "reactor: " << COUT_INTEGER << reactor.steps() << " steps, "
+              << reactor.idle_passes() << " idle passes, "
+              << COUT_FLOAT << (replicas * batches) / elapsed_s << " batches/s\n"
+              << std::endl;
+
+    if (!all_ok) {
+        std::cout << "ERROR: the sinks did not receive the streams of their sources!\n";
+        exit(-1);
+    }
+    std::cout << "Coroutine streams delivered every batch in order" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+# FraudDetection, `make host BENCHMARK=thr`, run with `./host sweep fd_thr.spec`
+results           = /home/root/pdp/benchmarks/fd/fd_thr
+dataset           = /home/root/datasets/fd/credit-card.dat
+model             = /home/root/datasets/fd/model.txt
+app_run_time_s    = 10
+sampling_rate     = 16
+warmup            = 1
+repetitions       = 10
+
+transfer          = shared
+pars              = 1,1,1,1 1,2,2,1 1,4,4,1 1,6,6,1
+source_buffers    = 2
+source_batch_size = 4 8 16 32 64 128 256 1024
+sink_buffers      = 2
+sink_batch_size   = 32
@@ -0,0 +1,125 @@
+// Host-side fill bandwidth of the source batches for each FAllocPolicy.
+// It mimics the source threads: tuples are copied from a dataset into
+// consecutive batches of `batch_size` tuples, cycling over a ring of `ring_mib` MiB,
+// either tuple by tuple (modulo per tuple) or with FDatasetRing.
+//
+// build: g++ -O3 -std=c++11 -I../FSPX/src/intel/ocl -I../FSPX/src/intel/runtime fill_bandwidth.cpp -o fill_bandwidth
+// usage: ./fill_bandwidth [ring_mib] [batch_size] [passes]
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <vector>
+
+#include "utils.hpp"
+#include "fill.hpp"
+
+
+struct tuple_t
+{
+    uint32_t key;
+    float property_value;
+    uint32_t timestamp;
+    uint32_t padding;
+};
+
+
+double fill_ring(tuple_t * ring,
+                 const size_t ring_elems,
+                 const f_vector<tuple_t> & dataset,
+                 const size_t batch_size,
+                 const size_t passes)
+{
+    const size_t batches = ring_elems / batch_size;
+    size_t next_tuple_idx = 0;
+
+    const uint64_t start_ns = current_time_ns();
+    for (size_t p = 0; p < passes; ++p) {
+        for (size_t b = 0; b < batches; ++b) {
+            tuple_t * batch = ring + b * batch_size;
+            for (size_t i = 0; i < batch_size; ++i) {
+                batch[i] = dataset[next_tuple_idx];
+                next_tuple_idx = (next_tuple_idx + 1) % dataset.size();
+            }
+        }
+    }
+    const uint64_t end_ns = current_time_ns();
+
+    const double bytes = double(passes) * batches * batch_size * sizeof(tuple_t);
+    return bytes / ((end_ns - start_ns) * 1e-9);
+}
+
+
+double fill_ring(tuple_t * ring,
+                 const size_t ring_elems,
+                 const FDatasetRing<tuple_t> & dataset,
+                 const size_t batch_size,
+                 const size_t passes)
+{
+    const size_t batches = ring_elems / batch_size;
+    size_t next_tuple_idx = 0;
+
+    const uint64_t start_ns = current_time_ns();
+    for (size_t p = 0; p < passes; ++p) {
+        for (size_t b = 0; b < batches; ++b) {
+            dataset.fill(ring + b * batch_size, batch_size, next_tuple_idx);
+        }
+    }
+    const uint64_t end_ns = current_time_ns();
+
+    const double bytes = double(passes) * batches * batch_size * sizeof(tuple_t);
+    return bytes / ((end_ns - start_ns) * 1e-9);
+}
+
+
+int main(int argc, char * argv[])
+{
+    size_t ring_mib = 256;
+    size_t batch_size = 1024;
+    size_t passes = 8;
+
+    argc--;
+    argv++;
+
+    int argi = 0;
+    if (argc > argi) ring_mib   = atoi(argv[argi++]);
+    if (argc > argi) batch_size = atoi(argv[argi++]);
+    if (argc > argi) passes     = atoi(argv[argi++]);
+
+    const size_t ring_elems = (ring_mib << 20) / sizeof(tuple_t);
+
+    f_vector<tuple_t> dataset(1 << 16);
+    for (size_t i = 0; i < dataset.size(); ++i) {
+        dataset[i].key = i % 64;
+        dataset[i].property_value = float(i);
+        dataset[i].timestamp = 0;
+        dataset[i].padding = 0;
+    }
+    FDatasetRing<tuple_t> dataset_ring(dataset.data(), dataset.size(), batch_size);
+
+    std::cout << COUT_HEADER << "ring: "       << COUT_INTEGER << ring_mib   << " MiB\n"
+              << COUT_HEADER << "batch_size: " << COUT_INTEGER << batch_size << '\n'
+              << COUT_HEADER << "passes: "     << COUT_INTEGER << passes     << '\n'
+              << std::endl;
+
+    for (FAllocPolicy policy : {FAllocPolicy::DEFAULT, FAllocPolicy::THP, FAllocPolicy::HUGETLB}) {
+        tuple_t * ring = f_alloc<tuple_t>(ring_elems, policy);
+
+        // first touch, page faults are measured apart
+        const uint64_t touch_start_ns = current_time_ns();
+        memset(ring, 0, ring_elems * sizeof(tuple_t));
+        const uint64_t touch_ns = current_time_ns() - touch_start_ns;
+
+        const double bandwidth_modulo = fill_ring(ring, ring_elems, dataset, batch_size, passes);
+        const double bandwidth_ring = fill_ring(ring, ring_elems, dataset_ring, batch_size, passes);
+
+        std::cout << COUT_HEADER << std::string(f_alloc_policy_str(policy)) + ": "
+                  << COUT_FLOAT << bandwidth_modulo / (1 << 20) << " MiB/s (modulo), "
+                  << COUT_FLOAT << bandwidth_ring / (1 << 20) << " MiB/s (ring), first touch: "
+                  << COUT_FLOAT << touch_ns / 1e6 << " ms" << std::endl;
+
+        f_free(ring);
+    }
+
+    return 0;
+}
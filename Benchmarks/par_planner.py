@@ -0,0 +1,91 @@
+# Chooses the par of each operator of a pipe under a resource budget, see
+# FSPX/fplanner.py. The profile is a JSON file:
+#   {"operators": [{"name": "predictor", "rate": 5e7, "cost": {"alm": 40000},
+#                   "selectivity": 1.0, "keyed": true, "keys": 262144}, ...],
+#    "budget": {"threads": 6, "alm": 300000}}
+# with the operators in pipe order (source and sink included) and `rate` the
+# tuples/s of one replica. --results takes the rates of the operators from a
+# run with device counters instead, of a single configuration: --config
+# selects it when the results hold more than one, --fmax is the kernel clock
+# (see the compilation report), a stall being one cycle.
+#
+# usage: python3 par_planner.py profile.json [--results results.jsonl --fmax MHz]
+#            [--config pars=1,2,2,1;source_batch_size=1024]
+#            [--budget threads=8,alm=400000] [--format py|pars|json]
+import os
+import sys
+import json
+import argparse
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+
+from FSPX.fplanner import FPlanner, FOperatorProfile, load_results_rates
+
+
+def parse_budget(s):
+    budget = {}
+    for kv in s.split(','):
+        if not kv:
+            continue
+        if '=' not in kv:
+            sys.exit("Malformed budget '" + kv + "', expected resource=value")
+        k, v = kv.split('=', 1)
+        budget[k.strip()] = float(v)
+    return budget
+
+
+def parse_config(s):
+    # ';'-separated, as a value (e.g., pars) may contain commas
+    config = {}
+    for kv in s.split(';'):
+        if not kv:
+            continue
+        if '=' not in kv:
+            sys.exit("Malformed config '" + kv + "', expected key=value")
+        k, v = kv.split('=', 1)
+        config[k.strip()] = v.strip()
+    return config
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Chooses the par of each operator under a resource budget.')
+    parser.add_argument('profile',
+                        help='JSON with "operators" (name, rate, cost, selectivity, keyed, keys, min_par, max_par) and "budget"')
+    parser.add_argument('--results', default=None,
+                        help='results .jsonl of an instrumented run, overrides the measured operator rates')
+    parser.add_argument('--fmax', type=float, default=None,
+                        help='kernel clock (MHz) of the instrumented run, needed by --results')
+    parser.add_argument('--config', default=None,
+                        help='semicolon-separated key=value, the configuration of the results to use')
+    parser.add_argument('--budget', default=None,
+                        help='comma-separated resource=value, overrides the budget of the profile')
+    parser.add_argument('--format', choices=['py', 'pars', 'json'], default='py')
+    args = parser.parse_args()
+
+    with open(args.profile) as file:
+        profile = json.load(file)
+
+    operators = [FOperatorProfile.from_dict(d) for d in profile['operators']]
+    budget = profile.get('budget', {})
+    if args.budget is not None:
+        budget = parse_budget(args.budget)
+
+    if args.results is not None:
+        if args.fmax is None or args.fmax <= 0:
+            sys.exit("--results needs the kernel clock of the run, --fmax MHz")
+        rates = load_results_rates(args.results, args.fmax * 1e6, parse_config(args.config or ''))
+        for op in operators:
+            if op.name in rates:
+                op.rate = rates[op.name]
+
+    plan = FPlanner(operators, budget).plan()
+    if args.format == 'py':
+        print('# ' + plan.report().replace('\n', '\n# '))
+        print(plan.to_python())
+    elif args.format == 'pars':
+        print(plan.to_pars())
+    else:
+        print(json.dumps(plan.to_dict(), indent=4))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,53 @@
+# Checks the service rates that FSPX/fplanner.py takes from the device
+# counters (load_results_rates) on a synthetic results record: at a 200 MHz
+# kernel clock, in a 1 s run, a replica at II = 1 that stalls 3/4 of the
+# time serves 200 Mtuples/s, one at II = 4 that stalls 1/5 of the time
+# serves 50 Mtuples/s, although both ran a loop iteration per cycle.
+#
+# usage: python3 planner_rates_check.py
+import os
+import sys
+import json
+import tempfile
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir))
+
+from FSPX.fplanner import load_results_rates
+
+
+CLOCK_HZ = 200e6
+
+
+def counters(name, tuples, read_stalls, write_stalls):
+    return {name + '_tuples_in':    {'mean': tuples},
+            name + '_tuples_out':   {'mean': tuples},
+            name + '_read_stalls':  {'mean': read_stalls},
+            name + '_write_stalls': {'mean': write_stalls}}
+
+
+def main():
+    record = {'app': 'check', 'pars': '1,1,2,1', 'repetitions': 1, 'time_ms': {'mean': 1000.0}}
+    record.update(counters('map_0', 50e6, 100e6, 50e6))       # II = 1: 50M busy cycles
+    record.update(counters('filter_0', 40e6, 30e6, 10e6))     # II = 4: 160M busy cycles
+    record.update(counters('filter_1', 40e6, 40e6, 0))
+    expected = {'map': 200e6, 'filter': 50e6}
+
+    with tempfile.NamedTemporaryFile('w', suffix='.jsonl', delete=False) as file:
+        file.write(json.dumps(record) + '\n')
+        filename = file.name
+    try:
+        rates = load_results_rates(filename, CLOCK_HZ)
+    finally:
+        os.remove(filename)
+
+    ok = set(rates) == set(expected)
+    for op, rate in sorted(rates.items()):
+        good = op in expected and abs(rate - expected[op]) <= 1e-9 * expected[op]
+        ok = ok and good
+        print('{:>12}: {:.4g} tuples/s (expected {:.4g})'.format(op, rate, expected.get(op, 0)))
+    if not ok:
+        sys.exit('ERROR: the service rates do not match!')
+    print('Service rates match')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,248 @@
+# Performance regression gate over two benchmark result sets.
+#
+# Reads the files written by `host sweep` (<results>.jsonl, or <results>.csv
+# when only the summary is available: one file per set of keys and metrics,
+# <results>.N.csv for the others), matches the configurations by their
+# keys (app, benchmark, transfer, pars, batch sizes, ...) and compares each
+# metric with Welch's t-test. A metric regresses when it is worse than the
+# baseline by more than `--threshold` and the difference is significant at
+# `--alpha` (with a single repetition on either side, the threshold alone
+# decides). The exit status is 1 if any metric regresses, 2 on bad input.
+#
+# usage: python3 regression_gate.py baseline.jsonl candidate.jsonl
+#            [--threshold 0.05] [--alpha 0.05] [--metrics throughput,latency_p95]
+#            [--ignore key1,key2] [--verbose]
+import sys
+import csv
+import json
+import math
+import argparse
+
+
+# Metrics where a lower value is better, all the others are higher-is-better
+LOWER_IS_BETTER = ('latency_', 'drop_ratio')
+
+DEFAULT_METRICS = ['throughput', 'total_bandwidth', 'latency_p50', 'latency_p95']
+
+
+class Summary:
+    def __init__(self, mean, stddev, n):
+        self.mean = mean
+        self.stddev = stddev
+        self.n = n
+
+
+def load_jsonl(filename):
+    results = []
+    with open(filename) as file:
+        for line in file:
+            line = line.strip()
+            if not line:
+                continue
+            record = json.loads(line)
+            config = {}
+            metrics = {}
+            for key, value in record.items():
+                if isinstance(value, dict):
+                    samples = value.get('samples', [])
+                    if len(samples) > 0:
+                        metrics[key] = summarize(samples)
+                    else:
+                        metrics[key] = Summary(value['mean'], value.get('stddev', 0), record.get('repetitions', 1))
+                elif key != 'repetitions':
+                    config[key] = str(value)
+            results.append((config, metrics))
+    return results
+
+
+def load_csv(filename):
+    results = []
+    with open(filename, newline='') as file:
+        reader = csv.DictReader(file)
+        metric_names = [c[:-len('_mean')] for c in reader.fieldnames if c.endswith('_mean')]
+        suffixes = tuple('_' + s for s in ('mean', 'stddev', 'ci95', 'n'))
+        config_keys = [c for c in reader.fieldnames
+                       if c != 'repetitions' and not (c.endswith(suffixes) and c.rsplit('_', 1)[0] in metric_names)]
+        for row in reader:
+            n = int(row.get('repetitions') or 1)
+            config = {k: row[k] for k in config_keys}
+            metrics = {}
+            for m in metric_names:
+                if row.get(m + '_mean', '') != '':
+                    # repetitions that have the metric, if it is missing from some
+                    metrics[m] = Summary(float(row[m + '_mean']), float(row.get(m + '_stddev') or 0), int(row.get(m + '_n') or n))
+            results.append((config, metrics))
+    return results
+
+
+def load(filename):
+    if filename.endswith('.csv'):
+        return load_csv(filename)
+    return load_jsonl(filename)
+
+
+def summarize(samples):
+    n = len(samples)
+    mean = sum(samples) / n
+    stddev = math.sqrt(sum((x - mean) ** 2 for x in samples) / (n - 1)) if n > 1 else 0.0
+    return Summary(mean, stddev, n)
+
+
+def merge(results, ignore):
+    # Repeated sweeps of the same configuration are pooled
+    merged = {}
+    for config, metrics in results:
+        key = tuple(sorted((k, v) for k, v in config.items() if k not in ignore))
+        entry = merged.setdefault(key, {})
+        for name, s in metrics.items():
+            if name not in entry:
+                entry[name] = s
+            else:
+                entry[name] = pool(entry[name], s)
+    return merged
+
+
+def pool(a, b):
+    n = a.n + b.n
+    mean = (a.mean * a.n + b.mean * b.n) / n
+    ss = (a.n - 1) * a.stddev ** 2 + (b.n - 1) * b.stddev ** 2 \
+        + a.n * (a.mean - mean) ** 2 + b.n * (b.mean - mean) ** 2
+    return Summary(mean, math.sqrt(ss / (n - 1)) if n > 1 else 0.0, n)
+
+
+def betacf(a, b, x):
+    # Continued fraction of the incomplete beta function (modified Lentz)
+    tiny = 1e-300
+    qab = a + b
+    qap = a + 1.0
+    qam = a - 1.0
+    c = 1.0
+    d = 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    h = d
+    for m in range(1, 300):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        delta = d * c
+        h *= delta
+        if abs(delta - 1.0) < 1e-12:
+            break
+    return h
+
+
+def betainc(a, b, x):
+    # Regularized incomplete beta function I_x(a, b)
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    lbeta = math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b)
+    front = math.exp(lbeta + a * math.log(x) + b * math.log(1.0 - x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return front * betacf(a, b, x) / a
+    return 1.0 - front * betacf(b, a, 1.0 - x) / b
+
+
+def welch_p_value(a, b):
+    # Two-sided p-value of Welch's t-test, None if it cannot be computed
+    if a.n < 2 or b.n < 2:
+        return None
+    va = a.stddev ** 2 / a.n
+    vb = b.stddev ** 2 / b.n
+    if va + vb == 0:
+        return 0.0 if a.mean != b.mean else 1.0
+    t = (b.mean - a.mean) / math.sqrt(va + vb)
+    df = (va + vb) ** 2 / (va ** 2 / (a.n - 1) + vb ** 2 / (b.n - 1))
+    return betainc(df / 2.0, 0.5, df / (df + t * t))
+
+
+def relative_change(metric, base, cand):
+    # Positive when the candidate is better
+    if base == 0:
+        return 0.0
+    change = (cand - base) / abs(base)
+    return -change if metric.startswith(LOWER_IS_BETTER) else change
+
+
+def config_str(key):
+    return ' '.join(k + '=' + v for k, v in key)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compares two benchmark result sets.')
+    parser.add_argument('baseline')
+    parser.add_argument('candidate')
+    parser.add_argument('--threshold', type=float, default=0.05,
+                        help='relative worsening that counts as a regression (default 0.05)')
+    parser.add_argument('--alpha', type=float, default=0.05,
+                        help='significance level of the t-test (default 0.05)')
+    parser.add_argument('--metrics', default=','.join(DEFAULT_METRICS),
+                        help='comma-separated metrics to compare')
+    parser.add_argument('--ignore', default='bitstream,alloc_policy',
+                        help='comma-separated configuration keys not used for matching')
+    parser.add_argument('--verbose', action='store_true',
+                        help='prints every comparison, not only the changed ones')
+    args = parser.parse_args()
+
+    metrics = [m for m in args.metrics.split(',') if m]
+    ignore = set(k for k in args.ignore.split(',') if k)
+
+    try:
+        baseline = merge(load(args.baseline), ignore)
+        candidate = merge(load(args.candidate), ignore)
+    except (OSError, ValueError, KeyError) as e:
+        print('ERROR: ' + str(e))
+        sys.exit(2)
+
+    matched = [k for k in baseline if k in candidate]
+    if not matched:
+        print('ERROR: no configuration in common between the two result sets!')
+        sys.exit(2)
+
+    regressions = 0
+    improvements = 0
+    compared = 0
+    for key in sorted(matched):
+        for m in metrics:
+            if m not in baseline[key] or m not in candidate[key]:
+                continue
+            a = baseline[key][m]
+            b = candidate[key][m]
+            change = relative_change(m, a.mean, b.mean)
+            p = welch_p_value(a, b)
+            significant = (p is None or p < args.alpha)
+            compared += 1
+
+            status = 'ok'
+            if change < -args.threshold and significant:
+                status = 'REGRESSION'
+                regressions += 1
+            elif change > args.threshold and significant:
+                status = 'improvement'
+                improvements += 1
+
+            if status != 'ok' or args.verbose:
+                print('{:<11} {:<16} {:>14.4g} -> {:<14.4g} {:>+7.1%}  p={:<7} {}'.format(
+                    status, m, a.mean, b.mean, change,
+                    '-' if p is None else '{:.4f}'.format(p), config_str(key)))
+
+    print('{} configurations matched ({} only in baseline, {} only in candidate), '
+          '{} comparisons: {} regressions, {} improvements'.format(
+              len(matched), len(baseline) - len(matched), len(candidate) - len(matched),
+              compared, regressions, improvements))
+
+    sys.exit(1 if regressions > 0 else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,14 @@
+# SpikeDetection, `make host BENCHMARK=lat`, run with `./host sweep sd_lat.spec`
+results           = /home/root/pdp/benchmarks/sd/sd_lat
+dataset           = /home/root/datasets/sd/sensors.dat
+app_run_time_s    = 10
+sampling_rate     = 16
+warmup            = 1
+repetitions       = 10
+
+transfer          = copy hybrid shared
+pars              = 1,1,1,1 2,1,1,1
+source_buffers    = 2
+source_batch_size = 16 32 64 128 256 512 1024 2048 4096
+sink_buffers      = 2
+sink_batch_size   = 256 1024
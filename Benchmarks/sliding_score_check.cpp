@@ -0,0 +1,207 @@
+// Equivalence of the incremental window score of the FD predictor
+// (FraudDetection/code/intel/device/nodes/predictor.cl) with the score of the
+// whole window (get_local_metric), on a model for both FLOAT_T.
+// The fixed-point running sum is checked bit by bit against the sum of the
+// window transitions (the HOT_SWAP_MODEL path) and against the window score
+// in long double. Windows of 2, `win_dim` and the largest supported WIN_DIM
+// are replayed from an empty state, with random and with maximum-score walks:
+// the sum must fit in score_sum_t (int40_t for SCORE_FRAC_BITS 32, long for
+// 56) and the window size in win_size_t (uint7_t, so at most 127).
+//
+// build: g++ -O3 -std=c++11 -I../FSPX/src/intel/ocl -I../FraudDetection/code/intel/includes sliding_score_check.cpp -o sliding_score_check
+// usage: ./sliding_score_check [model_path] [win_dim] [steps]
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+
+#include "utils.hpp"
+#include "dataset.hpp"
+
+
+template <typename T, int SCORE_FRAC_BITS, int SCORE_SUM_BITS>
+struct FSlidingScore
+{
+    const std::vector<T> & trans_prob;
+    const std::vector<T> & rowsum;
+    const size_t num_states;
+
+    const T score_one = static_cast<T>(uint64_t(1) << SCORE_FRAC_BITS);
+    const int64_t sum_max = std::numeric_limits<int64_t>::max() >> (64 - SCORE_SUM_BITS);
+    const size_t max_win_size = 127;    // win_size_t
+
+    FSlidingScore(const std::vector<T> & _trans_prob,
+                  const std::vector<T> & _rowsum,
+                  const size_t _num_states)
+    : trans_prob(_trans_prob)
+    , rowsum(_rowsum)
+    , num_states(_num_states)
+    {}
+
+    // get_transition_score of the predictor
+    int64_t transition_score(const size_t prev, const size_t curr) const {
+        return static_cast<int64_t>((rowsum[prev] - trans_prob[prev * num_states + curr]) * score_one);
+    }
+
+    int64_t max_transition_score() const {
+        int64_t max_score = 0;
+        for (size_t prev = 0; prev < num_states; ++prev) {
+            for (size_t curr = 0; curr < num_states; ++curr) {
+                max_score = std::max(max_score, transition_score(prev, curr));
+            }
+        }
+        return max_score;
+    }
+
+    // a full window holds WIN_DIM transitions between the add of the entering
+    // one and the subtract of the leaving one, and win_elems is a uint7_t
+    size_t max_win_dim() const {
+        return std::min<size_t>(sum_max / max_transition_score(), max_win_size);
+    }
+
+    bool fits(const int64_t sum) const {
+        return sum >= -sum_max - 1 && sum <= sum_max;
+    }
+
+    // replays `steps` states from an empty window, as predictor_function does
+    bool check(const size_t win_dim, const size_t steps, const bool max_walk) const {
+        std::mt19937 rng;
+        rng.seed(0);
+        std::uniform_int_distribution<std::mt19937::result_type> dist(0, num_states - 1);
+
+        std::vector<uint32_t> win(win_dim, 0);
+        size_t win_elems = 0;
+        int64_t score_sum = 0;
+        int64_t score_sum_peak = 0;
+
+        for (size_t k = 0; k < steps; ++k) {
+            uint32_t curr = dist(rng);
+            if (max_walk && win_elems > 0) {
+                for (uint32_t s = 0; s < num_states; ++s) {
+                    if (transition_score(win[win_dim - 1], s) > transition_score(win[win_dim - 1], curr)) curr = s;
+                }
+            }
+
+            if (win_elems > 0) {
+                score_sum += transition_score(win[win_dim - 1], curr);
+            }
+            score_sum_peak = std::max(score_sum_peak, std::abs(score_sum));
+            if (!fits(score_sum)) {
+                std::cout << "ERROR: score_sum overflows " << SCORE_SUM_BITS << " bits at step " << k << "!\n";
+                return false;
+            }
+            if (win_elems == win_dim) {
+                score_sum -= transition_score(win[0], win[1]);
+            }
+
+            for (size_t i = 0; i < win_dim - 1; ++i) {
+                win[i] = win[i + 1];
+            }
+            win[win_dim - 1] = curr;
+            if (win_elems < win_dim) {
+                win_elems++;
+            }
+
+            T score = 0;
+            if (win_elems == win_dim) {
+                score = (static_cast<T>(score_sum) / score_one) / (win_dim - 1);
+            }
+
+            // the window summed from scratch, in fixed point and with get_local_metric
+            int64_t window_sum = 0;
+            long double params[2] = {0, 0};
+            for (size_t i = win_dim - win_elems + 1; i < win_dim; ++i) {
+                window_sum += transition_score(win[i - 1], win[i]);
+                for (size_t j = 0; j < num_states; ++j) {
+                    if (j != win[i]) {
+                        params[0] += trans_prob[win[i - 1] * num_states + j];
+                    }
+                }
+                params[1] += 1;
+            }
+            const T expected = (win_elems == win_dim) ? static_cast<T>(params[0] / params[1]) : 0;
+
+            if (score_sum != window_sum) {
+                std::cout << "ERROR: running sum " << score_sum << " != window sum " << window_sum
+                          << " at step " << k << "!\n";
+                return false;
+            }
+            if (!approximatelyEqual<T>(score, expected, (sizeof(T) == sizeof(float) ? 1e-6 : 1e-15))) {
+                std::cout << "ERROR: score " << std::setprecision(16) << score << " != " << expected
+                          << " at step " << k << "!\n";
+                return false;
+            }
+        }
+
+        std::cout << COUT_HEADER << "win_dim " + std::to_string(win_dim) + (max_walk ? " max: " : " random: ")
+                  << COUT_FLOAT << std::log2(double(score_sum_peak)) << " bits peak\n";
+        return true;
+    }
+
+    bool run(const char * name, const size_t win_dim, const size_t steps) const {
+        const size_t win_dim_limit = max_win_dim();
+
+        std::cout << name << ": SCORE_FRAC_BITS " << SCORE_FRAC_BITS
+                  << ", " << SCORE_SUM_BITS << "-bit score_sum, WIN_DIM <= " << win_dim_limit << '\n';
+
+        if (win_dim > win_dim_limit) {
+            std::cout << "ERROR: WIN_DIM " << win_dim << " overflows score_sum_t or win_size_t!\n";
+            return false;
+        }
+
+        bool ok = true;
+        for (size_t w : {size_t(2), win_dim, win_dim_limit}) {
+            ok = ok && check(w, steps, false) && check(w, steps, true);
+        }
+        std::cout << std::endl;
+        return ok;
+    }
+};
+
+
+int main(int argc, char * argv[])
+{
+    std::string model_path = "../Datasets/FD/model.txt";
+    size_t win_dim = 5;
+    size_t steps = 1000000;
+
+    argc--;
+    argv++;
+
+    int argi = 0;
+    if (argc > argi) model_path = argv[argi++];
+    if (argc > argi) win_dim    = atoi(argv[argi++]);
+    if (argc > argi) steps      = atoi(argv[argi++]);
+
+    if (win_dim < 2) {
+        std::cout << "ERROR: WIN_DIM must be at least 2!\n";
+        exit(-1);
+    }
+
+    // the float model is the double one rounded, as get_model<float> would load it
+    const std::vector<double> trans_prob_d = get_model<double>(model_path);
+    const size_t num_states = get_num_states();
+    if (num_states == 0) {
+        std::cout << "ERROR: cannot load " << model_path << "!\n";
+        exit(-1);
+    }
+    const std::vector<float> trans_prob_f(trans_prob_d.begin(), trans_prob_d.end());
+    const std::vector<double> rowsum_d = get_rowsum(trans_prob_d, num_states);
+    const std::vector<float> rowsum_f = get_rowsum(trans_prob_f, num_states);
+
+    std::cout << COUT_HEADER << "model: " << model_path << '\n'
+              << COUT_HEADER << "states: " << COUT_INTEGER << num_states << '\n'
+              << COUT_HEADER << "steps: "  << COUT_INTEGER << steps << '\n'
+              << std::endl;
+
+    const bool ok_f = FSlidingScore<float, 32, 40>(trans_prob_f, rowsum_f, num_states).run("float", win_dim, steps);
+    const bool ok_d = FSlidingScore<double, 56, 64>(trans_prob_d, rowsum_d, num_states).run("double", win_dim, steps);
+
+    if (!ok_f || !ok_d) {
+        exit(-1);
+    }
+    std::cout << "Sliding score matches the window score" << std::endl;
+
+    return 0;
+}
@@ -3,4 +3,5 @@ from .fdispatch import FDispatchPolicy
 from .fbuffer import FBuffer, FBufferAccess
 from .fchannel import FChannel
 from .foperator import FOperator, FOperatorKind
-from .fapplication import FApplication, FTransferMode, FTarget
\ No newline at end of file
+from .fapplication import FApplication, FTransferMode, FTarget
+from .fplanner import FPlanner, FPlan, FOperatorProfile
\ No newline at end of file
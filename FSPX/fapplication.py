@@ -26,7 +26,8 @@ class FApplication:
                  target: FTarget = FTarget.INTEL,
                  transfer_mode: FTransferMode = FTransferMode.COPY,
                  codebase: str = None,
-                 constants: dict = {}):
+                 constants: dict = {},
+                 instrument: bool = False):
         assert dest_dir
         assert datatype
         assert isinstance(target, FTarget)
@@ -40,6 +41,7 @@ class FApplication:
         self.transfer_mode = transfer_mode
         self.codebase = codebase
         self.constants = constants
+        self.instrument = instrument    # device-side operator counters (Intel only)
 
         self.memory_reader = None
         self.internal_nodes = []
@@ -187,6 +189,10 @@ class FApplication:
             cur.i_degree = prv.par if prv is not None else 0
             cur.o_degree = nxt.par if nxt is not None else 0
 
+        # Enables the device counters of the operator kernels
+        for n in nodes:
+            n.instrument = self.instrument and n.kind in (FOperatorKind.MAP, FOperatorKind.FILTER, FOperatorKind.FLAT_MAP)
+
         # Updates input and output datatype
         for prv, cur, nxt in previous_current_next(nodes):
             cur.i_datatype = prv.o_datatype if prv is not None else self.datatype
@@ -232,6 +238,7 @@ class FGeneratorIntel:
         └── host
             └── includes
             └── metric
+            └── runtime
         """
         self.app.base_dir = self.app.dest_dir
         self.app.common_dir = path.join(self.app.base_dir, 'common')
@@ -245,10 +252,12 @@ class FGeneratorIntel:
         self.app.host_dir = path.join(self.app.base_dir, 'host')
         self.app.host_includes_dir = path.join(self.app.host_dir, 'includes')
         self.app.host_metric_dir = path.join(self.app.host_dir, 'metric')
+        self.app.host_runtime_dir = path.join(self.app.host_dir, 'runtime')
 
         for folder in (self.app.base_dir, self.app.common_dir, self.app.ocl_dir,
                        self.app.device_dir, self.app.device_includes_dir, self.app.device_nodes_dir,
-                       self.app.host_dir, self.app.host_includes_dir, self.app.host_metric_dir):
+                       self.app.host_dir, self.app.host_includes_dir, self.app.host_metric_dir,
+                       self.app.host_runtime_dir):
             if not path.isdir(folder):
                 os.mkdir(folder)
 
@@ -540,7 +549,7 @@ class FGeneratorIntel:
 
 
         template_subpath = ("intel" if self.app.target == FTarget.INTEL else "xilinx")
-        # Copy codebase files (host.cpp, dataset.hpp)
+        # Copy codebase files (host.cpp, dataset.hpp, workload.hpp)
         # TODO: formalize which files are copied
 
         # HOST.CPP
@@ -553,11 +562,18 @@ class FGeneratorIntel:
         if path.isfile(filename):
             copyfile(filename, path.join(self.app.host_includes_dir, 'dataset.hpp'))
 
+        # WORKLOAD.HPP
+        filename = path.join(self.app.codebase, 'includes', 'workload.hpp')
+        if path.isfile(filename):
+            copyfile(filename, path.join(self.app.host_includes_dir, 'workload.hpp'))
+
         template = read_template_file(self.app.dest_dir, 'host.cpp')
         filename = path.join(self.app.host_dir, 'host.cpp')
         if not path.isfile(filename) or rewrite_host:
             file = open(filename, mode='w+')
-            result = template.render(nodes=self.app.internal_nodes,
+            result = template.render(app_name=self.app.dest_dir,
+                                     nodes=self.app.internal_nodes,
+                                     instrument=self.app.instrument,
                                      source=self.app.memory_reader,
                                      sink=self.app.memory_writer,
                                      transfer_mode=self.app.transfer_mode,
@@ -577,7 +593,7 @@ class FGeneratorIntel:
 
         # Metric
         metric_dir = os.path.join(os.path.dirname(__file__), "src", template_subpath, 'metric')
-        files = ['metric_group.hpp', 'metric.hpp', 'sampler.hpp']
+        files = ['metric_group.hpp', 'metric.hpp', 'sampler.hpp', 'report.hpp']
 
         for f in files:
             src_path = path.join(metric_dir, f)
@@ -585,6 +601,16 @@ class FGeneratorIntel:
             if not path.isfile(dest_path):
                 copyfile(src_path, dest_path)
 
+        # Runtime
+        runtime_dir = os.path.join(os.path.dirname(__file__), "src", template_subpath, 'runtime')
+        files = ['fill.hpp', 'rate.hpp', 'sweep.hpp', 'monitor.hpp', 'counters.hpp', 'latency.hpp', 'breakdown.hpp', 'reactor.hpp', 'coro.hpp', 'consumer.hpp', 'input.hpp', 'workload.hpp']
+
+        for f in files:
+            src_path = path.join(runtime_dir, f)
+            dest_path = path.join(self.app.host_runtime_dir, f)
+            if not path.isfile(dest_path):
+                copyfile(src_path, dest_path)
+
         # Makefile
         make_src_dir = os.path.join(os.path.dirname(__file__), "src", template_subpath, 'Makefile')
         make_dst_dir = path.join(self.app.base_dir, 'Makefile')
@@ -656,6 +682,8 @@ class FGeneratorXilinx:
             # if n.is_generator() or n.is_drainer():
             #     if n.has_compute_function():
             #         print(n.name + ": compute function is not generated for Xilinx target")
+        if self.app.instrument:
+            print("device instrumentation is not generated for Xilinx target")
 
 
 ################################################################################
@@ -863,6 +891,12 @@ class FGeneratorXilinx:
                 if rewrite or not path.isfile(dest_path):
                     copyfile(src_path, dest_path)
 
+        # the results schema of the Intel hosts, shared by the regression gate
+        src_path = os.path.join(os.path.dirname(__file__), 'src', 'intel', 'metric', 'report.hpp')
+        dest_path = path.join(self.app.host_includes_dir, 'report.hpp')
+        if rewrite or not path.isfile(dest_path):
+            copyfile(src_path, dest_path)
+
 
     def generate_main(self, rewrite=False):
         filename = path.join(self.app.host_dir, 'host.cpp')
@@ -143,10 +143,13 @@ class FBufferLocal(FBuffer):
                  name: str,
                  size=1,
                  value=None,
-                 attributes=None):
+                 attributes=None,
+                 ivdep=None):           # True or a safelen: the operator loop ignores the
+                                        # dependencies through this buffer (#pragma ivdep)
         super().__init__(datatype, name, size)
         self.value = value
         self.attributes = attributes
+        self.ivdep = ivdep
         self.visibility = '__local'
 
     def is_ptr_parameter(self):
@@ -186,6 +189,15 @@ class FBufferLocal(FBuffer):
             return self.name
         return '&' + self.name
 
+    def has_ivdep(self):
+        return self.ivdep is not None and self.ivdep is not False
+
+    def ivdep_pragma(self):
+        d = '#pragma ivdep array(' + self.name + ')'
+        if self.ivdep is not True:
+            d += ' safelen(' + str(self.ivdep) + ')'
+        return d
+
 
 class FBufferGlobal(FBuffer):
     def __init__(self,
@@ -194,15 +206,19 @@ class FBufferGlobal(FBuffer):
                  size=1,
                  access: FBufferAccess = FBufferAccess.READ_ALL,
                  ptr: bool = True,      # set ptr = False if you need to pass a single value to kernel
-                 value=None):           # and fill its value
+                 value=None,            # and fill its value
+                 hot_swap: bool = False):   # can be replaced while the kernels run (volatile)
         super().__init__(datatype, name, size)
         self.access = access
         self.ptr = ptr
         self.value = value
+        self.hot_swap = hot_swap
         if not self.ptr and self.size[0] > 1:
             sys.exit(self.name + ' FBufferGlobal has to be of size = 1 if ptr is False')
         if not self.ptr and self.value is None:
             sys.exit(self.name + ' FBufferGlobal needs a value if ptr is False')
+        if self.hot_swap and (not self.ptr or not self.is_read_only()):
+            sys.exit(self.name + ' FBufferGlobal can be hot swapped only if ptr is True and it is read only')
         self.visibility = '__global'
 
     def has_value(self):
@@ -229,17 +245,22 @@ class FBufferGlobal(FBuffer):
     def is_access_all(self):
         return self.access in (FBufferAccess.READ_ALL, FBufferAccess.WRITE_ALL, FBufferAccess.RW_ALL)
 
+    def is_hot_swap(self):
+        return self.hot_swap
+
     def declare(self):
         sys.exit('never call this function on FBufferGlobal')
 
     def parameter(self):
         const = ('const ' if self.is_read_only() else '')
         if self.is_ptr_parameter():
-            return const + ' '.join([self.visibility,
-                                     self.datatype,
-                                     '*',
-                                     'restrict',
-                                     self.name])
+            # the kernels must not cache a buffer that changes while they run
+            return const + ' '.join([self.visibility]
+                                    + (['volatile'] if self.hot_swap else [])
+                                    + [self.datatype,
+                                       '*',
+                                       'restrict',
+                                       self.name])
         else:
             return const + ' '.join([self.datatype,
                                      self.name])
@@ -259,11 +280,15 @@ class FBufferGlobal(FBuffer):
         return 'CL_MEM_READ_WRITE'
 
     def get_queues_name(self, idx=None):
-        return self.name + '_buffer_queues' + ('' if idx is None else '[' + str(idx) +']')
+        # shared by all the global buffers of the node, see FOperator.get_buffer_queues_count
+        return 'buffer_queues' + ('' if idx is None else '[' + str(idx) +']')
 
     def get_buffers_name(self, idx=None):
         return self.name + '_buffers' + ('' if idx is None else '[' + str(idx) +']')
 
+    def get_shadows_name(self, idx=None):
+        return self.name + '_shadows' + ('' if idx is None else '[' + str(idx) +']')
+
     def get_declare_and_init(self):
         if self.has_value():
             return ' '.join([self.datatype,
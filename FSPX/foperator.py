@@ -59,6 +59,7 @@ class FOperator:
         self.i_channel = None
         self.o_channel = None
         self.buffers = []
+        self.instrument = False
 
     def check_buffer_duplicate(self, name):
         for b in self.buffers:
@@ -82,10 +83,13 @@ class FOperator:
                          name: str,
                          size: int = 1,
                          value=None,
-                         attributes=None):
+                         attributes=None,
+                         ivdep=None):
         if self.check_buffer_duplicate(name):
             sys.exit('Buffer "' + name + '" in node "' + self.name + '" is already present!')
-        self.buffers.append(FBufferLocal(datatype, name, size, value, attributes))
+        if ivdep is not None and ivdep is not True and (type(ivdep) is not int or ivdep < 1):
+            sys.exit('"ivdep" of buffer "' + name + '" must be True or a safelen of at least 1')
+        self.buffers.append(FBufferLocal(datatype, name, size, value, attributes, ivdep))
 
     def add_global_buffer(self,
                           datatype: str,
@@ -93,10 +97,11 @@ class FOperator:
                           size: int = 1,
                           access: FBufferAccess = FBufferAccess.READ_ALL,
                           ptr: bool = True,
-                          value=None):
+                          value=None,
+                          hot_swap: bool = False):
         if self.check_buffer_duplicate(name):
             sys.exit('Buffer "' + name + '" in node "' + self.name + '" is already present!')
-        self.buffers.append(FBufferGlobal(datatype, name, size, access, ptr, value))
+        self.buffers.append(FBufferGlobal(datatype, name, size, access, ptr, value, hot_swap))
 
     def get_buffers(self):
         return self.buffers
@@ -107,12 +112,25 @@ class FOperator:
     def get_local_buffers(self):
         return [b for b in self.buffers if type(b) is FBufferLocal]
 
+    def get_ivdep_buffers(self):
+        return [b for b in self.get_local_buffers() if b.has_ivdep()]
+
     def get_global_value_buffers(self):
         return [b for b in self.buffers if type(b) is FBufferGlobal and b.has_value()]
 
     def get_global_no_value_buffers(self):
         return [b for b in self.buffers if type(b) is FBufferGlobal and not b.has_value()]
 
+    def get_hot_swap_buffers(self):
+        return [b for b in self.get_global_no_value_buffers() if b.is_hot_swap()]
+
+    # the global buffers of a node share its host queues, one per replica
+    # if any of them is accessed by a single replica
+    def get_buffer_queues_count(self):
+        if any(b.is_access_single() for b in self.get_global_no_value_buffers()):
+            return 'par'
+        return 1
+
     def get_global_buffers(self):
         # return [b for b in self.buffers if type(b) is FBufferGlobal]
         wo_value = self.get_global_no_value_buffers()
@@ -243,6 +261,9 @@ class FOperator:
     def declare_local_buffers(self):
         return ''.join([b.declare() + ';\n' for b in self.get_local_buffers()])
 
+    def declare_ivdep(self):
+        return '\n'.join([b.ivdep_pragma() for b in self.get_ivdep_buffers()])
+
     def declare_global_buffers(self):
         return ''.join([b.declare() + ';\n' for b in self.get_global_buffers()])
 
@@ -282,6 +303,25 @@ class FOperator:
     def use_global_buffers(self):
         return ', '.join([b.use() for b in self.get_global_buffers()])
 
+# Instrumentation
+    # Each replica counts the tuples it reads and writes and the attempts of
+    # the non-blocking channel reads and writes that found the channel empty
+    # (read stalls) or full (write stalls). At EOS it stores them in its own
+    # STATS_FIELDS entries of the `fspx_stats` global buffer.
+    STATS_FIELDS = 4
+
+    def instrument_reads(self):
+        return self.instrument
+
+    def instrument_writes(self):
+        # flat_map writes from the user function, where the counters are not visible
+        return self.instrument and not self.is_flat_map()
+
+    def parameter_stats(self):
+        if not self.instrument:
+            return ''
+        return (', ' if len(self.get_global_buffers()) > 0 else '') + '__global ulong * restrict fspx_stats'
+
 # Tuples
     def i_tupletype(self):
         return self.i_channel.tupletype
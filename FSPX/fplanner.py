@@ -0,0 +1,253 @@
+# Parallelism planner
+#
+# Chooses the par of each operator from its measured service rate, so that the
+# throughput of the pipe is maximum under a resource budget (FPGA area, host
+# threads, ...). The throughput of a pipe is bounded by its slowest stage:
+#
+#   T = min_i (par_i * rate_i / load_i)
+#
+# where rate_i is the service rate of one replica (tuples/s) and load_i the
+# tuples that reach operator i for each tuple entering the pipe (product of
+# the selectivities of the operators before it). Costs are additive per
+# replica, so raising the current bottleneck by the smallest valid step is
+# optimal: every other stage already meets the target at its minimum cost.
+#
+# Keyed operators (KB dispatch into them) keep their state at `key / PAR`, so
+# each replica owns next_power_of_two(keys / par) entries: their par is kept
+# to powers of two that do not exceed the number of keys.
+#
+# Command line: Benchmarks/par_planner.py
+import sys
+import json
+import math
+
+
+def next_power_of_two(n):
+    return 1 if n <= 1 else 2**(n - 1).bit_length()
+
+
+class FOperatorProfile:
+    def __init__(self,
+                 name: str,
+                 rate: float,
+                 cost: dict = None,
+                 selectivity: float = 1.0,
+                 keyed: bool = False,
+                 keys: int = 0,
+                 min_par: int = 1,
+                 max_par: int = 64):
+        assert name
+        assert rate > 0
+        assert selectivity >= 0
+        assert 1 <= min_par <= max_par
+        assert not keyed or keys > 0
+
+        self.name = name
+        self.rate = rate                # tuples/s of a single replica
+        self.cost = cost if cost is not None else {}
+        self.selectivity = selectivity  # output tuples per input tuple
+        self.keyed = keyed
+        self.keys = keys
+        self.min_par = min_par
+        self.max_par = min(max_par, keys) if keyed else max_par
+
+    def valid(self, par):
+        if par < self.min_par or par > self.max_par:
+            return False
+        return not self.keyed or (par & (par - 1)) == 0
+
+    def next_par(self, par):
+        p = par + 1
+        while p <= self.max_par and not self.valid(p):
+            p += 1
+        return p if p <= self.max_par else None
+
+    def first_par(self):
+        p = self.min_par
+        while p <= self.max_par and not self.valid(p):
+            p += 1
+        if p > self.max_par:
+            sys.exit(self.name + ": no valid par in [" + str(self.min_par) + ", " + str(self.max_par) + "]")
+        return p
+
+    def state_size(self, par):
+        # entries of the keyed state of each replica
+        return next_power_of_two(math.ceil(self.keys / par)) if self.keyed else 0
+
+    @staticmethod
+    def from_dict(d):
+        return FOperatorProfile(d['name'],
+                                float(d['rate']),
+                                d.get('cost', {}),
+                                float(d.get('selectivity', 1.0)),
+                                bool(d.get('keyed', False)),
+                                int(d.get('keys', 0)),
+                                int(d.get('min_par', 1)),
+                                int(d.get('max_par', 64)))
+
+
+class FPlan:
+    def __init__(self, operators, pars, loads, budget):
+        self.operators = operators
+        self.pars = pars
+        self.loads = loads
+        self.budget = budget
+
+    def stage_throughput(self, i):
+        op = self.operators[i]
+        return self.pars[i] * op.rate / self.loads[i] if self.loads[i] > 0 else math.inf
+
+    def throughput(self):
+        return min(self.stage_throughput(i) for i in range(len(self.operators)))
+
+    def bottleneck(self):
+        return min(range(len(self.operators)), key=self.stage_throughput)
+
+    def usage(self):
+        used = {}
+        for op, par in zip(self.operators, self.pars):
+            for r, c in op.cost.items():
+                used[r] = used.get(r, 0) + c * par
+        return used
+
+    def par_of(self, name):
+        for op, par in zip(self.operators, self.pars):
+            if op.name == name:
+                return par
+        return None
+
+    def apply(self, app):
+        # sets the par of the FApplication nodes with the same names (before generate_*)
+        for n in app.get_nodes():
+            par = self.par_of(n.name)
+            if par is not None:
+                n.par = par
+
+    def to_pars(self):
+        # the `pars` argument of the hosts, e.g., "2,1,1,1"
+        return ','.join(str(p) for p in self.pars)
+
+    def to_python(self):
+        lines = []
+        for op, par in zip(self.operators, self.pars):
+            lines.append('{}_par = {}'.format(op.name, par))
+        for op, par in zip(self.operators, self.pars):
+            if op.keyed:
+                lines.append('{}_state_size = {}    # next_power_of_two({} // {}_par)'.format(
+                    op.name, op.state_size(par), op.keys, op.name))
+        return '\n'.join(lines)
+
+    def to_dict(self):
+        return {'pars': {op.name: p for op, p in zip(self.operators, self.pars)},
+                'throughput': self.throughput(),
+                'bottleneck': self.operators[self.bottleneck()].name,
+                'usage': self.usage(),
+                'budget': self.budget}
+
+    def report(self):
+        lines = ['{:<20} {:>5} {:>16} {:>10}'.format('operator', 'par', 'stage tuples/s', 'load')]
+        for i, op in enumerate(self.operators):
+            lines.append('{:<20} {:>5} {:>16.4g} {:>10.4g}'.format(op.name, self.pars[i], self.stage_throughput(i), self.loads[i]))
+        used = self.usage()
+        lines.append('throughput: {:.4g} tuples/s, bottleneck: {}'.format(self.throughput(), self.operators[self.bottleneck()].name))
+        for r in sorted(set(used) | set(self.budget)):
+            lines.append('{}: {:g} / {}'.format(r, used.get(r, 0), self.budget.get(r, 'unbounded')))
+        return '\n'.join(lines)
+
+
+class FPlanner:
+    def __init__(self,
+                 operators: list,
+                 budget: dict = None):
+        assert len(operators) > 0
+        self.operators = operators
+        self.budget = budget if budget is not None else {}
+
+        # tuples that reach each operator for each tuple that enters the pipe
+        self.loads = []
+        load = 1.0
+        for op in operators:
+            self.loads.append(load)
+            load *= op.selectivity
+
+    def fits(self, pars):
+        used = FPlan(self.operators, pars, self.loads, self.budget).usage()
+        return all(used.get(r, 0) <= b for r, b in self.budget.items())
+
+    def plan(self):
+        pars = [op.first_par() for op in self.operators]
+        if not self.fits(pars):
+            sys.exit("The budget cannot fit a single replica of each operator!")
+
+        while True:
+            plan = FPlan(self.operators, pars, self.loads, self.budget)
+            b = plan.bottleneck()
+            p = self.operators[b].next_par(pars[b])
+            if p is None:
+                break
+            candidate = list(pars)
+            candidate[b] = p
+            if not self.fits(candidate):
+                break
+            pars = candidate
+
+        return FPlan(self.operators, pars, self.loads, self.budget)
+
+
+def load_results_rates(filename, clock_hz, config=None):
+    # Per-replica service rates from a run with device counters
+    # (FApplication(instrument=True)), as written by `host sweep`. A stall is
+    # a failed non-blocking channel attempt, one cycle of the kernel clock
+    # `clock_hz`: a replica is busy for the time of the run minus its stalls,
+    # and its service rate is tuples / busy time. (Iterations per second
+    # would be about the clock for every operator, whatever its II.)
+    # The rates depend on the configuration (pars, batch sizes, ...), so the
+    # records must all be of one configuration: the ones whose keys match
+    # `config` (key -> value), repeated sweeps of it are averaged.
+    config = config or {}
+    rates = {}
+    matched = None
+    with open(filename) as file:
+        for line in file:
+            line = line.strip()
+            if not line:
+                continue
+            record = json.loads(line)
+            if 'time_ms' not in record:
+                continue
+            record_config = {k: str(v) for k, v in record.items()
+                             if not isinstance(v, dict) and k != 'repetitions'}
+            if any(record_config.get(k) != v for k, v in config.items()):
+                continue
+            time_s = record['time_ms']['mean'] * 1e-3
+            counters = {}
+            for key, value in record.items():
+                for c in ('tuples_in', 'read_stalls', 'write_stalls'):
+                    if isinstance(value, dict) and key.endswith('_' + c):
+                        op_replica = key[:-len(c) - 1]
+                        op = op_replica.rsplit('_', 1)[0]
+                        counters.setdefault(op, {}).setdefault(op_replica, {})[c] = value['mean']
+            if not counters:
+                continue
+            if matched is None:
+                matched = record_config
+            elif record_config != matched:
+                diff = sorted(k for k in set(matched) | set(record_config)
+                              if matched.get(k) != record_config.get(k))
+                sys.exit(filename + ": the results are of more than one configuration (they differ in "
+                         + ", ".join(diff) + "), select one with --config key=value")
+            for op, replicas in counters.items():
+                for op_replica, r in replicas.items():
+                    tuples = r.get('tuples_in', 0)
+                    stalls = r.get('read_stalls', 0) + r.get('write_stalls', 0)
+                    if tuples <= 0 or time_s <= 0:
+                        continue
+                    busy_s = time_s - stalls / clock_hz
+                    if busy_s <= 0:
+                        sys.exit(filename + ": " + op_replica + " stalled for longer than the run, "
+                                 "is the kernel clock " + str(clock_hz / 1e6) + " MHz right?")
+                    rates.setdefault(op, []).append(tuples / busy_s)
+    if matched is None:
+        sys.exit(filename + ": no results with device counters"
+                 + (" for " + ",".join(k + "=" + v for k, v in config.items()) if config else ""))
+    return {op: sum(v) / len(v) for op, v in rates.items()}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <numeric>
+#include <iomanip>
+
+namespace util {
+
+// Repetitions of one benchmark configuration. Every application writes the
+// same schema: the configuration keys, `repetitions`, then mean/stddev/ci95
+// of each metric. One JSON object per line (with the raw samples) and one
+// CSV row per configuration. A metric may be missing from some repetitions
+// (e.g., latency_* without samples): its statistics are over the repetitions
+// that have it, and their indices are kept.
+class Report {
+
+private:
+
+    struct Samples
+    {
+        std::vector<size_t> repetitions;    // index of each value
+        std::vector<double> values;
+    };
+
+    std::vector<std::pair<std::string, std::string>> config_;
+    std::vector<std::pair<std::string, Samples>> metrics_;
+    size_t repetitions_ = 0;
+
+    // two-sided 95% quantiles of Student's t, df = 1..30
+    static double t95(const size_t df) {
+        static const double table[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                          2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                          2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+        if (df == 0) return 0;
+        return (df <= 30) ? table[df - 1] : 1.96;
+    }
+
+    static bool exists(const std::string & filepath) {
+        std::ifstream f(filepath);
+        return f.good();
+    }
+
+    static std::string csv_escape(const std::string & s) {
+        return (s.find(',') == std::string::npos) ? s : ("\"" + s + "\"");
+    }
+
+public:
+
+    void config(const std::string & key, const std::string & value) {
+        config_.emplace_back(key, value);
+    }
+
+    // starts a repetition, the metrics added next belong to it
+    void repetition() {
+        repetitions_++;
+    }
+
+    void add(const std::string & metric, const double value) {
+        if (repetitions_ == 0) repetitions_ = 1;
+        for (auto & m : metrics_) {
+            if (m.first == metric) {
+                m.second.repetitions.push_back(repetitions_ - 1);
+                m.second.values.push_back(value);
+                return;
+            }
+        }
+        metrics_.emplace_back(metric, Samples());
+        metrics_.back().second.repetitions.push_back(repetitions_ - 1);
+        metrics_.back().second.values.push_back(value);
+    }
+
+    size_t repetitions() const {
+        return repetitions_;
+    }
+
+    static double mean(const std::vector<double> & v) {
+        return v.empty() ? 0 : std::accumulate(v.begin(), v.end(), 0.0) / v.size();
+    }
+
+    static double stddev(const std::vector<double> & v) {
+        if (v.size() < 2) return 0;
+        const double m = mean(v);
+        double sum = 0;
+        for (double x : v) sum += (x - m) * (x - m);
+        return std::sqrt(sum / (v.size() - 1));
+    }
+
+    // half-width of the 95% confidence interval of the mean
+    static double ci95(const std::vector<double> & v) {
+        if (v.size() < 2) return 0;
+        return t95(v.size() - 1) * stddev(v) / std::sqrt(double(v.size()));
+    }
+
+    void write_jsonl(const std::string & filepath) const {
+        std::ofstream out(filepath, std::ios_base::app);
+        out << std::setprecision(12) << '{';
+        for (auto & c : config_) {
+            out << '"' << c.first << "\":\"" << c.second << "\",";
+        }
+        out << "\"repetitions\":" << repetitions();
+        for (auto & m : metrics_) {
+            const std::vector<double> & v = m.second.values;
+            out << ",\"" << m.first << "\":{"
+                << "\"mean\":" << mean(v) << ','
+                << "\"stddev\":" << stddev(v) << ','
+                << "\"ci95\":" << ci95(v) << ','
+                << "\"samples\":[";
+            for (size_t i = 0; i < v.size(); ++i) {
+                out << (i ? "," : "") << v[i];
+            }
+            out << ']';
+            if (v.size() != repetitions()) {
+                out << ",\"repetitions\":[";
+                for (size_t i = 0; i < v.size(); ++i) {
+                    out << (i ? "," : "") << m.second.repetitions[i];
+                }
+                out << ']';
+            }
+            out << '}';
+        }
+        out << "}\n";
+    }
+
+    // `_n` is the number of repetitions that have the metric
+    std::string csv_header() const {
+        std::ostringstream out;
+        for (auto & c : config_) {
+            out << c.first << ',';
+        }
+        out << "repetitions";
+        for (auto & m : metrics_) {
+            out << ',' << m.first << "_mean"
+                << ',' << m.first << "_stddev"
+                << ',' << m.first << "_ci95"
+                << ',' << m.first << "_n";
+        }
+        return out.str();
+    }
+
+    // One file per schema: the rows of a configuration with other keys or
+    // metrics than the first row of `filepath` go to <name>.2.csv, <name>.3.csv, ...
+    void write_csv(const std::string & filepath) const {
+        const std::string header = csv_header();
+        const size_t dot = filepath.rfind(".csv");
+        const std::string base = (dot == std::string::npos) ? filepath : filepath.substr(0, dot);
+
+        std::string path = filepath;
+        for (size_t n = 2; exists(path); ++n) {
+            std::ifstream in(path);
+            std::string line;
+            std::getline(in, line);
+            if (line == header) break;
+            path = base + "." + std::to_string(n) + ".csv";
+        }
+
+        const bool write_header = !exists(path);
+        std::ofstream out(path, std::ios_base::app);
+        if (write_header) {
+            out << header << '\n';
+        }
+        out << std::setprecision(12);
+        for (auto & c : config_) {
+            out << csv_escape(c.second) << ',';
+        }
+        out << repetitions();
+        for (auto & m : metrics_) {
+            const std::vector<double> & v = m.second.values;
+            out << ',' << mean(v)
+                << ',' << stddev(v)
+                << ',' << ci95(v)
+                << ',' << v.size();
+        }
+        out << '\n';
+    }
+
+    // writes `<prefix>.jsonl` and `<prefix>.csv`
+    void write(const std::string & prefix) const {
+        write_jsonl(prefix + ".jsonl");
+        write_csv(prefix + ".csv");
+    }
+};
+
+}
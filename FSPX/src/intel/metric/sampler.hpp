@@ -18,7 +18,7 @@ private:
 
     uint64_t _current_time_ns() {
         struct timespec t;
-        clock_gettime(CLOCK_REALTIME, &t);
+        clock_gettime(CLOCK_MONOTONIC, &t);
         return (t.tv_sec) * uint64_t(1000000000) + t.tv_nsec;
     }
 
@@ -12,6 +12,7 @@ struct clSharedBuffer
 
     cl_command_queue queue;
     cl_mem buffer;
+    void * host_ptr;
     T * _ptr;
     volatile T * _ptr_volatile;
 
@@ -24,7 +25,9 @@ struct clSharedBuffer
     , buffer_flags(buffer_flags)
     , is_volatile(is_volatile)
     {
-        queue = ocl.createCommandQueue();
+        queue = ocl.getQueue(FQueueRole::MAP, 0);  // pooled, owned by OCL
+        buffer = NULL;
+        host_ptr = nullptr;
         _ptr = nullptr;
         _ptr_volatile = nullptr;
     }
@@ -33,11 +36,36 @@ struct clSharedBuffer
              cl_event * event = NULL,
              bool blocking = true)
     {
-        cl_int status;
-        buffer = clCreateBuffer(ocl.context,
-                                CL_MEM_ALLOC_HOST_PTR | buffer_flags,
-                                size * sizeof(T),
-                                NULL, &status);
+        cl_int status = CL_INVALID_VALUE;
+
+        // huge pages: the ring is allocated by f_alloc and handed to the runtime,
+        // if the runtime refuses it we fall back to its own allocation
+        if (f_alloc_policy() != FAllocPolicy::DEFAULT) {
+            host_ptr = f_alloc_bytes(size * sizeof(T));
+            buffer = clCreateBuffer(ocl.context,
+                                    CL_MEM_USE_HOST_PTR | buffer_flags,
+                                    size * sizeof(T),
+                                    host_ptr, &status);
+            if (status != CL_SUCCESS) {
+                f_free(host_ptr);
+                host_ptr = nullptr;
+
+                static bool warned = false;
+                if (!warned) {
+                    warned = true;
+                    std::cerr << "clSharedBuffer: CL_MEM_USE_HOST_PTR rejected ("
+                              << clErrorToString(status)
+                              << "), falling back to CL_MEM_ALLOC_HOST_PTR" << std::endl;
+                }
+            }
+        }
+
+        if (status != CL_SUCCESS) {
+            buffer = clCreateBuffer(ocl.context,
+                                    CL_MEM_ALLOC_HOST_PTR | buffer_flags,
+                                    size * sizeof(T),
+                                    NULL, &status);
+        }
         clCheckErrorMsg(status, "Failed to create clBufferShared");
         if (is_volatile) {
             _ptr_volatile = (volatile T *)clEnqueueMapBuffer(queue, buffer,
@@ -64,5 +92,10 @@ struct clSharedBuffer
         if (_ptr and buffer) clCheckError(clEnqueueUnmapMemObject(queue, buffer, _ptr, 0, NULL, NULL));
         if (_ptr_volatile and buffer) clCheckError(clEnqueueUnmapMemObject(queue, buffer, (void*)_ptr_volatile, 0, NULL, NULL));
         if (buffer) clCheckError(clReleaseMemObject(buffer));
+        if (host_ptr) {
+            clFinish(queue);
+            f_free(host_ptr);
+            host_ptr = nullptr;
+        }
     }
 };
\ No newline at end of file
@@ -2,16 +2,55 @@
 
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <tuple>
+#include <string>
+#include <utility>
 
 #include "opencl.hpp"
 #include "utils.hpp"
 
+// Roles of the command queues handed out by OCL::getQueue
+enum class FQueueRole
+{
+    KERNEL,     // one per kernel: a persistent kernel never leaves its in-order queue
+    WRITE,      // host to device, never waits for a kernel
+    READ,       // device to host, waits for the kernel that produced the data
+    MAP         // map/unmap of the shared buffers, at setup and teardown only
+};
+
+// The context, the programs loaded in it and their kernel objects outlive
+// the pipes: init with the same platform and device keeps the context, a
+// binary already loaded is not loaded and built again, and createKernel
+// hands out the same kernel object for a name (arguments are captured at
+// enqueue time, so the replica that owns a name can reuse its object).
 struct OCL
 {
-    cl_platform_id platform;
-    cl_device_id device;
-    cl_context context;
-    cl_program program;
+    cl_platform_id platform = nullptr;
+    cl_device_id device = nullptr;
+    cl_context context = nullptr;
+    cl_program program = nullptr;
+
+    int platform_id = -1;
+    int device_id = -1;
+    std::map<std::string, cl_program> programs;                             // by binary file
+    std::map<std::pair<cl_program, std::string>, cl_kernel> kernels;        // by program and name
+    std::map<std::tuple<FQueueRole, std::string, bool>, cl_command_queue> queues;  // by role, key and order, see getQueue
+
+    // Out-of-order queues for the copy and hybrid transfers (FSourceCopy,
+    // FSinkCopy, FSourceHybrid, FSinkHybrid): one queue per replica, the order
+    // of writes, kernels and reads is only the one of their wait lists. Read
+    // by the pipes when they are created.
+    bool out_of_order = false;
+
+    // startup phases of the last init, 0 if skipped
+    double context_ms = 0;
+    double program_ms = 0;
+    size_t kernels_created = 0;
+    size_t kernels_reused = 0;
+    size_t queues_created = 0;
+    size_t queues_reused = 0;
+    double queues_ms = 0;               // spent creating them
 
     void init(const std::string & filename,
               int platform_id = -1,
@@ -20,38 +59,128 @@ struct OCL
     {
         std::cout << "Loading " << filename << std::flush;
 
-        platform = (platform_id < 0) ? clPromptPlatform() : clSelectPlatform(platform_id);
-        device = (device_id < 0) ? clPromptDevice(platform) : clSelectDevice(platform, device_id);
-        context = clCreateContextFor(platform, device);
+        context_ms = 0;
+        program_ms = 0;
+
+        // interactive selections (id < 0) are never reused
+        if (context == nullptr or platform_id < 0 or device_id < 0
+            or platform_id != this->platform_id or device_id != this->device_id) {
+            clean();
 
-        volatile cl_ulong time_start = current_time_ns();
-        program = clCreateBuildProgramFromBinary(context, device, filename);
-        volatile cl_ulong time_end = current_time_ns();
+            volatile cl_ulong time_start = current_time_ns();
+            platform = (platform_id < 0) ? clPromptPlatform() : clSelectPlatform(platform_id);
+            device = (device_id < 0) ? clPromptDevice(platform) : clSelectDevice(platform, device_id);
+            context = clCreateContextFor(platform, device);
+            volatile cl_ulong time_end = current_time_ns();
+
+            this->platform_id = platform_id;
+            this->device_id = device_id;
+            context_ms = (time_end - time_start) * 1.0e-6;
+        }
+
+        auto it = programs.find(filename);
+        if (it == programs.end()) {
+            volatile cl_ulong time_start = current_time_ns();
+            program = clCreateBuildProgramFromBinary(context, device, filename);
+            volatile cl_ulong time_end = current_time_ns();
+
+            programs[filename] = program;
+            program_ms = (time_end - time_start) * 1.0e-6;
+        } else {
+            program = it->second;
+        }
 
         if (show_build_time) {
-            const double time_total = (time_end - time_start) * 1.0e-6;
             std::cout << ": "
-                      << COUT_FLOAT << time_total << " ms"
+                      << COUT_FLOAT << program_ms << " ms"
+                      << (program_ms == 0 ? " (already loaded)" : "")
                       << std::endl;
+        } else {
+            std::cout << std::endl;
         }
     }
 
-    cl_command_queue createCommandQueue() {
+    cl_command_queue createCommandQueue(const bool out_of_order = false) {
+        cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE;
+        if (out_of_order) {
+            if (!(deviceInfo<cl_command_queue_properties>(device, CL_DEVICE_QUEUE_PROPERTIES) & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)) {
+                std::cout << "ERROR: the device does not support out-of-order queues!\n";
+                exit(-1);
+            }
+            properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+        }
         cl_int status;
-        cl_command_queue queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &status);
+        cl_command_queue queue = clCreateCommandQueue(context, device, properties, &status);
         clCheckErrorMsg(status, "Failed to create command queue");
         return queue;
     }
 
+    // Pooled queues, owned by OCL (never released by the caller). A WRITE or
+    // READ queue is shared by all the nodes and buffers of a replica, so the
+    // pool grows with the replicas and not with the buffers, and commands of
+    // different replicas never wait for each other. READ queues are kept apart
+    // from WRITE queues: a read waits for its kernel, a write queued behind it
+    // could be the one that feeds that kernel.
+    cl_command_queue getQueue(const FQueueRole role,
+                              const size_t replica_id)
+    {
+        return getQueue(role, std::to_string(role == FQueueRole::MAP ? 0 : replica_id));
+    }
+
+    // KERNEL queues are keyed by the kernel name. Out-of-order queues are
+    // never shared with in-order ones.
+    cl_command_queue getQueue(const FQueueRole role,
+                              const std::string & key,
+                              const bool out_of_order = false)
+    {
+        const std::tuple<FQueueRole, std::string, bool> k(role, key, out_of_order);
+        auto it = queues.find(k);
+        if (it == queues.end()) {
+            volatile cl_ulong time_start = current_time_ns();
+            cl_command_queue queue = createCommandQueue(out_of_order);
+            volatile cl_ulong time_end = current_time_ns();
+
+            queues_ms += (time_end - time_start) * 1.0e-6;
+            queues_created++;
+            it = queues.emplace(k, queue).first;
+        } else {
+            queues_reused++;
+        }
+        return it->second;
+    }
+
+    // the caller releases the kernel, the cache keeps its own reference
     cl_kernel createKernel(const std::string & kernel_name) {
-        cl_int status;
-        cl_kernel kernel = clCreateKernel(program, kernel_name.c_str(), &status);
-        clCheckErrorMsg(status, "Failed to create kernel");
-        return kernel;
+        const std::pair<cl_program, std::string> key(program, kernel_name);
+        auto it = kernels.find(key);
+        if (it == kernels.end()) {
+            cl_int status;
+            cl_kernel kernel = clCreateKernel(program, kernel_name.c_str(), &status);
+            clCheckErrorMsg(status, "Failed to create kernel");
+            it = kernels.emplace(key, kernel).first;
+            kernels_created++;
+        } else {
+            kernels_reused++;
+        }
+        clCheckError(clRetainKernel(it->second));
+        return it->second;
     }
 
     void clean() {
-        if (program) clReleaseProgram(program);
+        for (auto & q : queues) {
+            clReleaseCommandQueue(q.second);
+        }
+        for (auto & k : kernels) {
+            clReleaseKernel(k.second);
+        }
+        for (auto & p : programs) {
+            clReleaseProgram(p.second);
+        }
         if (context) clReleaseContext(context);
+        queues.clear();
+        kernels.clear();
+        programs.clear();
+        program = nullptr;
+        context = nullptr;
     }
-};
\ No newline at end of file
+};
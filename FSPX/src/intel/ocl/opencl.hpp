@@ -412,6 +412,23 @@ cl_ulong clTimeBetweenEventsNS(cl_event start, cl_event end)
     return timeEnd - timeStart;
 }
 
+// CL_PROFILING_COMMAND_{QUEUED,SUBMIT,START,END} of a completed event, in ns
+cl_ulong clEventProfilingTime(cl_event event, cl_profiling_info info)
+{
+    cl_ulong time = 0;
+    clGetEventProfilingInfo(event, info, sizeof(time), &time, NULL);
+    return time;
+}
+
+// true once the command of `event` completed (or failed: clWaitForEvents
+// reports the error)
+bool clEventDone(cl_event event)
+{
+    cl_int status = CL_COMPLETE;
+    clGetEventInfo(event, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+    return status <= CL_COMPLETE;
+}
+
 double clTimeBetweenEventsMS(cl_event start, cl_event end)
 {
     return 1.e-6 * clTimeBetweenEventsNS(start, end);
@@ -5,21 +5,150 @@
 #include <cstdint>
 #include <cmath>
 #include <random>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unordered_map>
 #include <sys/time.h>
+#include <sys/mman.h>
 
 #define AOCL_ALIGNMENT  64
+#define HUGE_PAGE_SIZE  (2 * 1024 * 1024)
 
-template <typename T>
-T * f_alloc(const size_t elems)
+// Backing pages used by f_alloc
+enum struct FAllocPolicy {
+    DEFAULT,    // posix_memalign with AOCL_ALIGNMENT (4 KiB pages)
+    THP,        // 2 MiB aligned + madvise(MADV_HUGEPAGE), transparent huge pages
+    HUGETLB     // mmap(MAP_HUGETLB), explicit huge pages (needs vm.nr_hugepages)
+};
+
+inline FAllocPolicy & f_alloc_policy()
+{
+    static FAllocPolicy policy = FAllocPolicy::DEFAULT;
+    return policy;
+}
+
+inline const char * f_alloc_policy_str(const FAllocPolicy policy)
+{
+    switch (policy) {
+        case FAllocPolicy::THP:     return "thp";
+        case FAllocPolicy::HUGETLB: return "hugetlb";
+        default:                    return "default";
+    }
+}
+
+// returns false if `str` is not one of "default", "thp" or "hugetlb"
+inline bool f_alloc_set_policy(const std::string & str)
+{
+    if (str.compare("default") == 0)      f_alloc_policy() = FAllocPolicy::DEFAULT;
+    else if (str.compare("thp") == 0)     f_alloc_policy() = FAllocPolicy::THP;
+    else if (str.compare("hugetlb") == 0) f_alloc_policy() = FAllocPolicy::HUGETLB;
+    else return false;
+    return true;
+}
+
+// regions obtained with mmap(MAP_HUGETLB) have to be released with munmap
+inline std::mutex & f_alloc_mmap_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline std::unordered_map<void *, size_t> & f_alloc_mmap_regions()
 {
-    T * ptr = NULL;
-    int ret = posix_memalign((void **)&ptr, AOCL_ALIGNMENT, elems * sizeof(T));
+    static std::unordered_map<void *, size_t> regions;
+    return regions;
+}
+
+// Allocations smaller than half a huge page always use 4 KiB pages:
+// a 2 MiB page would be mostly wasted and would not save TLB entries.
+// Every huge page request falls back to the next policy on failure
+// (HUGETLB -> THP -> DEFAULT), so the allocation never fails because of it.
+inline void * f_alloc_bytes(const size_t bytes,
+                            const FAllocPolicy policy = f_alloc_policy())
+{
+    void * ptr = NULL;
+    const bool huge = (policy != FAllocPolicy::DEFAULT) && (bytes >= HUGE_PAGE_SIZE / 2);
+    const size_t huge_bytes = ((bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE;
+
+#ifdef MAP_HUGETLB
+    if (huge and policy == FAllocPolicy::HUGETLB) {
+        ptr = mmap(NULL, huge_bytes,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                   -1, 0);
+        if (ptr != MAP_FAILED) {
+            std::lock_guard<std::mutex> lock(f_alloc_mmap_mutex());
+            f_alloc_mmap_regions()[ptr] = huge_bytes;
+            return ptr;
+        }
+        ptr = NULL;
+
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            std::cerr << "f_alloc: MAP_HUGETLB failed (no huge pages reserved?), falling back to THP" << std::endl;
+        }
+    }
+#endif
+
+    if (huge and posix_memalign(&ptr, HUGE_PAGE_SIZE, huge_bytes) == 0) {
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, huge_bytes, MADV_HUGEPAGE);
+#endif
+        return ptr;
+    }
+
+    int ret = posix_memalign(&ptr, AOCL_ALIGNMENT, bytes);
     if (ret != 0) {
         exit(ret);
     }
     return ptr;
 }
 
+inline void f_free(void * ptr)
+{
+    if (ptr == NULL) return;
+
+    {
+        std::lock_guard<std::mutex> lock(f_alloc_mmap_mutex());
+        auto it = f_alloc_mmap_regions().find(ptr);
+        if (it != f_alloc_mmap_regions().end()) {
+            munmap(ptr, it->second);
+            f_alloc_mmap_regions().erase(it);
+            return;
+        }
+    }
+    free(ptr);
+}
+
+template <typename T>
+T * f_alloc(const size_t elems,
+            const FAllocPolicy policy = f_alloc_policy())
+{
+    return static_cast<T *>(f_alloc_bytes(elems * sizeof(T), policy));
+}
+
+// std::allocator replacement backed by f_alloc (e.g., for datasets)
+template <typename T>
+struct f_allocator
+{
+    typedef T value_type;
+
+    f_allocator() = default;
+    template <typename U> f_allocator(const f_allocator<U> &) {}
+
+    T * allocate(const size_t n) { return f_alloc<T>(n); }
+    void deallocate(T * ptr, const size_t) { f_free(ptr); }
+
+    template <typename U> bool operator==(const f_allocator<U> &) const { return true; }
+    template <typename U> bool operator!=(const f_allocator<U> &) const { return false; }
+};
+
+template <typename T>
+using f_vector = std::vector<T, f_allocator<T> >;
+
 #define SHARED_SLEEP_ENABLE             1
 #define SHARED_SLEEP_TIME_US            5
 
@@ -51,21 +180,21 @@ T * f_alloc(const size_t elems)
 ALWAYS_INLINE uint64_t current_time_ns()
 {
     struct timespec t;
-    clock_gettime(CLOCK_REALTIME, &t);
+    clock_gettime(CLOCK_MONOTONIC, &t);
     return (t.tv_sec) * uint64_t(1000000000) + t.tv_nsec;
 }
 
 ALWAYS_INLINE uint64_t current_time_us()
 {
     struct timespec t;
-    clock_gettime(CLOCK_REALTIME, &t);
+    clock_gettime(CLOCK_MONOTONIC, &t);
     return (t.tv_sec) * uint64_t(1000000) + t.tv_nsec / uint64_t(1000);
 }
 
 ALWAYS_INLINE uint64_t current_time_ms()
 {
     struct timespec t;
-    clock_gettime(CLOCK_REALTIME, &t);
+    clock_gettime(CLOCK_MONOTONIC, &t);
     return (t.tv_sec) * uint64_t(1000) + t.tv_nsec / uint64_t(1000000);
 }
 
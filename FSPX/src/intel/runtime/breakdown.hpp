@@ -0,0 +1,254 @@
+#pragma once
+
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "utils.hpp"
+
+#ifndef F_CACHE_LINE_SIZE
+#define F_CACHE_LINE_SIZE 64
+#endif
+
+// Stages of the life of a batch. Host stages are differences of
+// current_time_ns() stamps, device stages are differences of the OpenCL
+// profiling counters of the same command (or of commands on the same
+// device). The two clocks are never mixed, so the stages are not a partition
+// of the end-to-end latency_ns: they tell where a batch waits.
+enum FLatencyStage : size_t
+{
+    F_STAGE_SLOT_WAIT,      // host:   get_batch, waiting for a free N-buffer slot
+    F_STAGE_FILL,           // host:   get_batch return -> push (filling the batch)
+    F_STAGE_WRITE_QUEUE,    // device: write buffer queued -> started
+    F_STAGE_WRITE,          // device: write buffer started -> ended (DMA)
+    F_STAGE_LAUNCH,         // device: batch on the device (or kernel queued) -> source kernel started
+    F_STAGE_SOURCE_KERNEL,  // device: source kernel started -> ended (batch accepted by the pipe)
+    F_STAGE_SINK_KERNEL,    // device: sink kernel started -> ended (batch collected from the pipe)
+    F_STAGE_READ_QUEUE,     // device: sink kernel ended -> read buffer started
+    F_STAGE_READ,           // device: read buffer started -> ended (DMA)
+    F_STAGE_POP_WAIT,       // host:   pop, waiting for the batch
+    F_STAGE_HOLD,           // host:   pop return -> put_batch (consuming the batch)
+    F_STAGES
+};
+
+inline const char * f_stage_name(const size_t stage)
+{
+    static const char * names[F_STAGES] = {
+        "slot_wait", "fill", "write_queue", "write", "launch", "source_kernel",
+        "sink_kernel", "read_queue", "read", "pop_wait", "hold"
+    };
+    return names[stage];
+}
+
+inline bool f_stage_on_device(const size_t stage)
+{
+    return stage >= F_STAGE_WRITE_QUEUE and stage <= F_STAGE_READ;
+}
+
+// b - a, or 0 if the counters are not ordered (e.g., a command not profiled)
+ALWAYS_INLINE uint64_t f_stage_ns(const uint64_t a,
+                                  const uint64_t b)
+{
+    return (b > a) ? (b - a) : 0;
+}
+
+
+// Log-linear histogram of nanoseconds: 4 buckets per power of two, so a
+// percentile is within 12.5% of the exact value, with a fixed size and an
+// O(1) insert. Count, sum, min and max are exact.
+struct FHistogram
+{
+    static const size_t SUB_BITS = 2;
+    static const size_t SUBS = 1 << SUB_BITS;
+    static const size_t BUCKETS = 64 * SUBS;
+
+    uint64_t buckets[BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+
+    FHistogram() { clear(); }
+
+    void clear()
+    {
+        std::fill(buckets, buckets + BUCKETS, 0);
+        count = 0;
+        sum = 0;
+        min = UINT64_MAX;
+        max = 0;
+    }
+
+    static ALWAYS_INLINE size_t bucket_of(const uint64_t v)
+    {
+        if (v < SUBS) return v;
+        const size_t e = 63 - __builtin_clzll(v);
+        const size_t sub = (v >> (e - SUB_BITS)) & (SUBS - 1);
+        return (e - SUB_BITS + 1) * SUBS + sub;
+    }
+
+    static uint64_t bucket_low(const size_t b)
+    {
+        if (b < SUBS) return b;
+        const size_t e = b / SUBS + SUB_BITS - 1;
+        return uint64_t(SUBS + b % SUBS) << (e - SUB_BITS);
+    }
+
+    ALWAYS_INLINE void add(const uint64_t v)
+    {
+        buckets[bucket_of(v)]++;
+        count++;
+        sum += v;
+        min = std::min(min, v);
+        max = std::max(max, v);
+    }
+
+    void merge(const FHistogram & h)
+    {
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            buckets[b] += h.buckets[b];
+        }
+        count += h.count;
+        sum += h.sum;
+        min = std::min(min, h.min);
+        max = std::max(max, h.max);
+    }
+
+    double mean() const
+    {
+        return count ? double(sum) / count : 0;
+    }
+
+    // midpoint of the bucket of the p-th sample, clamped to [min, max]
+    double percentile(const double p) const
+    {
+        if (count == 0) return 0;
+        const uint64_t rank = static_cast<uint64_t>((count - 1) * p);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen > rank) {
+                const double low = bucket_low(b);
+                const double high = (b < bucket_of(UINT64_MAX)) ? bucket_low(b + 1) : low;
+                return std::min<double>(std::max<double>((low + high) / 2, min), max);
+            }
+        }
+        return max;
+    }
+};
+
+
+// Histograms of one source or sink replica, written only by its thread
+struct alignas(F_CACHE_LINE_SIZE) FBreakdownReplica
+{
+    FHistogram stages[F_STAGES];
+    uint64_t last_ns;   // get_batch return (sources) or pop return (sinks)
+
+    FBreakdownReplica()
+    : last_ns(0)
+    {}
+};
+
+
+// Per-stage latency of the batches of a run. FPipeGraph stamps the host
+// stages, the source and sink nodes attribute the device stages from the
+// profiling events of their commands (COPY and HYBRID only: SHARED kernels
+// are persistent and have no per-batch command).
+struct FLatencyBreakdown
+{
+    size_t source_par;
+    size_t sink_par;
+    FBreakdownReplica * sources;
+    FBreakdownReplica * sinks;
+
+    FLatencyBreakdown(const size_t source_par,
+                      const size_t sink_par)
+    : source_par(source_par)
+    , sink_par(sink_par)
+    , sources(alloc(source_par))
+    , sinks(alloc(sink_par))
+    {}
+
+    FLatencyBreakdown(const FLatencyBreakdown &) = delete;
+    FLatencyBreakdown & operator=(const FLatencyBreakdown &) = delete;
+
+    ~FLatencyBreakdown()
+    {
+        release(sources, source_par);
+        release(sinks, sink_par);
+    }
+
+    FBreakdownReplica & source(const size_t rid) { return sources[rid]; }
+    FBreakdownReplica & sink(const size_t rid)   { return sinks[rid]; }
+
+    // all the replicas, to be called once the source and sink threads joined
+    FHistogram total(const size_t stage) const
+    {
+        FHistogram h;
+        for (size_t rid = 0; rid < source_par; ++rid) h.merge(sources[rid].stages[stage]);
+        for (size_t rid = 0; rid < sink_par; ++rid)   h.merge(sinks[rid].stages[stage]);
+        return h;
+    }
+
+    void print() const
+    {
+        std::cout << COUT_HEADER << "stage"
+                  << std::setw(8)  << "clock"
+                  << std::setw(12) << "batches"
+                  << std::setw(12) << "mean_us"
+                  << std::setw(12) << "p50_us"
+                  << std::setw(12) << "p95_us"
+                  << std::setw(12) << "p99_us" << '\n';
+        for (size_t s = 0; s < F_STAGES; ++s) {
+            const FHistogram h = total(s);
+            if (h.count == 0) continue;
+            std::cout << COUT_HEADER << f_stage_name(s)
+                      << std::setw(8)  << (f_stage_on_device(s) ? "device" : "host")
+                      << std::setw(12) << h.count
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(12) << h.mean() * 1e-3
+                      << std::setw(12) << h.percentile(0.50) * 1e-3
+                      << std::setw(12) << h.percentile(0.95) * 1e-3
+                      << std::setw(12) << h.percentile(0.99) * 1e-3 << '\n';
+        }
+        std::cout << std::endl;
+    }
+
+    // stage_<name>_{mean,p50,p95} in ns, for the stages with samples
+    void append_metrics(std::vector<std::pair<std::string, double>> & metrics) const
+    {
+        for (size_t s = 0; s < F_STAGES; ++s) {
+            const FHistogram h = total(s);
+            if (h.count == 0) continue;
+            const std::string prefix = std::string("stage_") + f_stage_name(s) + "_";
+            metrics.emplace_back(prefix + "mean", h.mean());
+            metrics.emplace_back(prefix + "p50",  h.percentile(0.50));
+            metrics.emplace_back(prefix + "p95",  h.percentile(0.95));
+        }
+    }
+
+private:
+
+    static FBreakdownReplica * alloc(const size_t n)
+    {
+        if (n == 0) return nullptr;
+        FBreakdownReplica * r = static_cast<FBreakdownReplica *>(f_alloc_bytes(n * sizeof(FBreakdownReplica), FAllocPolicy::DEFAULT));
+        for (size_t rid = 0; rid < n; ++rid) {
+            new (r + rid) FBreakdownReplica();
+        }
+        return r;
+    }
+
+    static void release(FBreakdownReplica * r, const size_t n)
+    {
+        if (r == nullptr) return;
+        for (size_t rid = 0; rid < n; ++rid) {
+            r[rid].~FBreakdownReplica();
+        }
+        f_free(r);
+    }
+};
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <functional>
+
+#include "utils.hpp"
+#include "counters.hpp"
+
+// Result consumers: a sink replica hands each popped batch to the consumers
+// as a read-only view of the batch the pipe returned (the f_alloc batch in
+// COPY mode, the clSharedBuffer slot in HYBRID and SHARED modes), so results
+// leave the FPGA without a host copy. The slot goes back to the pipe
+// (put_batch) only once every consumer released the view.
+//
+// A replica may hold at most N batches (its N-buffering): the pipe reuses
+// the slot of the oldest held batch for the next pop, so a replica does not
+// pop while N of its batches are held.
+
+
+// A read-only sink batch, valid until every consumer released it
+template <typename T>
+struct FBatchView
+{
+    const T * data;
+    size_t size;
+    size_t rid;
+    bool last;
+    std::atomic<uint32_t> * refs;
+
+    const T * begin() const { return data; }
+    const T * end() const   { return data + size; }
+    const T & operator[](const size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+
+    // gives the batch back, from any thread, at most once per consumer
+    void release() const { refs->fetch_sub(1, std::memory_order_release); }
+};
+
+
+template <typename T>
+struct FResultConsumer
+{
+    virtual ~FResultConsumer() {}
+
+    // called by the sink replica that popped the batch: true if the batch
+    // can be released on return, false if the consumer keeps `view` and
+    // calls view.release() later
+    virtual bool consume(const FBatchView<T> & view) = 0;
+};
+
+
+// Runs `fun` on every batch, inline on the sink replica
+template <typename T>
+struct FResultCallback : FResultConsumer<T>
+{
+    std::function<void(const FBatchView<T> &)> fun;
+
+    FResultCallback(std::function<void(const FBatchView<T> &)> fun)
+    : fun(fun)
+    {}
+
+    bool consume(const FBatchView<T> & view)
+    {
+        fun(view);
+        return true;
+    }
+};
+
+
+// Hands the batches to a downstream thread: one single-producer ring per sink
+// replica. The rings never overflow, a replica holds at most N batches.
+template <typename T>
+struct FResultRing : FResultConsumer<T>
+{
+    struct alignas(F_CACHE_LINE_SIZE) Ring
+    {
+        FBatchView<T> * views;
+        size_t mask;
+        std::atomic<size_t> tail;               // written by the sink replica
+        alignas(F_CACHE_LINE_SIZE) size_t head; // read and written by the downstream thread
+
+        Ring()
+        : views(nullptr)
+        , mask(0)
+        , tail(0)
+        , head(0)
+        {}
+    };
+
+    size_t par;
+    Ring * rings;
+
+    FResultRing(const size_t par,
+                const size_t N)
+    : par(par)
+    , rings(f_new_blocks<Ring>(par))
+    {
+        for (size_t rid = 0; rid < par; ++rid) {
+            rings[rid].mask = next_pow2(N) - 1;
+            rings[rid].views = new FBatchView<T>[rings[rid].mask + 1];
+        }
+    }
+
+    FResultRing(const FResultRing &) = delete;
+    FResultRing & operator=(const FResultRing &) = delete;
+
+    ~FResultRing()
+    {
+        for (size_t rid = 0; rid < par; ++rid) {
+            delete[] rings[rid].views;
+        }
+        f_delete_blocks(rings, par);
+    }
+
+    bool consume(const FBatchView<T> & view)
+    {
+        Ring & r = rings[view.rid];
+        const size_t tail = r.tail.load(std::memory_order_relaxed);
+        r.views[tail & r.mask] = view;
+        r.tail.store(tail + 1, std::memory_order_release);
+        return false;
+    }
+
+    // the oldest batch of replica `rid` not taken yet, to be released by
+    // the caller (downstream thread only)
+    bool try_pop(const size_t rid,
+                 FBatchView<T> & view)
+    {
+        Ring & r = rings[rid];
+        if (r.head == r.tail.load(std::memory_order_acquire)) return false;
+        view = r.views[r.head & r.mask];
+        r.head++;
+        return true;
+    }
+
+    // runs `fun` on the pending batches of all the replicas and releases
+    // them, returns the number of batches
+    template <typename Fun>
+    size_t drain(Fun fun)
+    {
+        size_t n = 0;
+        FBatchView<T> view;
+        for (size_t rid = 0; rid < par; ++rid) {
+            while (try_pop(rid, view)) {
+                fun(view);
+                view.release();
+                n++;
+            }
+        }
+        return n;
+    }
+};
+
+
+// The consumers of a pipe and the batches each sink replica holds for them.
+// Held batches are given back to the pipe in pop order (SHARED releases the
+// oldest header) by the replica itself.
+template <typename T>
+struct FResultConsumers
+{
+    struct Slot
+    {
+        T * batch;
+        std::atomic<uint32_t> refs;
+    };
+
+    // written only by its sink replica
+    struct alignas(F_CACHE_LINE_SIZE) Held
+    {
+        Slot * slots;
+        size_t capacity;
+        size_t head;    // oldest held batch
+        size_t tail;    // next pop
+
+        Held()
+        : slots(nullptr)
+        , capacity(0)
+        , head(0)
+        , tail(0)
+        {}
+    };
+
+    size_t par;
+    Held * held;
+    std::vector<FResultConsumer<T> *> consumers;
+
+    FResultConsumers(const size_t par,
+                     const size_t N)
+    : par(par)
+    , held(f_new_blocks<Held>(par))
+    {
+        for (size_t rid = 0; rid < par; ++rid) {
+            held[rid].capacity = std::max<size_t>(1, N);
+            held[rid].slots = new Slot[held[rid].capacity];
+        }
+    }
+
+    FResultConsumers(const FResultConsumers &) = delete;
+    FResultConsumers & operator=(const FResultConsumers &) = delete;
+
+    ~FResultConsumers()
+    {
+        for (size_t rid = 0; rid < par; ++rid) {
+            delete[] held[rid].slots;
+        }
+        f_delete_blocks(held, par);
+    }
+
+    // before the replicas start
+    void add(FResultConsumer<T> * consumer) { consumers.push_back(consumer); }
+
+    bool full(const size_t rid) const  { return held[rid].tail - held[rid].head == held[rid].capacity; }
+    bool empty(const size_t rid) const { return held[rid].tail == held[rid].head; }
+
+    // hands a popped batch to the consumers, it stays held until all of
+    // them released it
+    void deliver(const size_t rid,
+                 T * batch,
+                 const size_t received,
+                 const bool last)
+    {
+        Held & h = held[rid];
+        Slot & s = h.slots[h.tail % h.capacity];
+        s.batch = batch;
+        s.refs.store(static_cast<uint32_t>(consumers.size()), std::memory_order_relaxed);
+        h.tail++;
+
+        const FBatchView<T> view = {batch, received, rid, last, &s.refs};
+        for (auto c : consumers) {
+            if (c->consume(view)) view.release();
+        }
+    }
+
+    // put_batch of the released batches, in pop order; returns how many
+    template <typename Pipe>
+    size_t give_back(Pipe & pipe,
+                     const size_t rid)
+    {
+        Held & h = held[rid];
+        size_t n = 0;
+        while (h.head != h.tail) {
+            Slot & s = h.slots[h.head % h.capacity];
+            if (s.refs.load(std::memory_order_acquire) != 0) break;
+            pipe.put_batch(rid, s.batch);
+            h.head++;
+            n++;
+        }
+        return n;
+    }
+
+    // blocking variants, for a replica on its own thread
+    template <typename Pipe>
+    void wait_slot(Pipe & pipe,
+                   const size_t rid)
+    {
+        while (full(rid)) {
+            if (give_back(pipe, rid) == 0) std::this_thread::yield();
+        }
+    }
+
+    template <typename Pipe>
+    void drain(Pipe & pipe,
+               const size_t rid)
+    {
+        while (!empty(rid)) {
+            if (give_back(pipe, rid) == 0) std::this_thread::yield();
+        }
+    }
+};
@@ -0,0 +1,256 @@
+#pragma once
+
+// Coroutine layer over FPipeGraph (C++20, e.g., `make CXX_STD=c++20`).
+// Each logical stream is a coroutine that co_awaits get_batch, push, pop and
+// put_batch instead of blocking a thread; FReactor is the executor, so many
+// streams are served by a few OS threads:
+//
+//   FCoro source(FPipeGraph<input_t, tuple_t> & pipe, size_t rid, ...)
+//   {
+//       bool done = false;
+//       while (!done) {
+//           input_t * batch = co_await f_get_batch(pipe, rid);
+//           ...fill the batch inline...
+//           co_await f_push(pipe, batch, n, rid, done);
+//       }
+//   }
+//
+//   FReactor reactor(2);
+//   std::vector<FCoro> streams;
+//   streams.push_back(source(pipe, 0, ...));
+//   for (auto & s : streams) reactor.add(&s);
+//   reactor.start();
+//   pipe.wait_and_stop();
+//   reactor.join();
+//
+// An awaitable never blocks: a coroutine whose awaitable is not ready stays
+// parked, and its reactor thread polls it on every pass (event status for
+// COPY/HYBRID, header_ready for SHARED).
+
+#if defined(__cpp_impl_coroutine) && __cplusplus >= 202002L
+
+#define F_COROUTINES 1
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <type_traits>
+
+#include "utils.hpp"
+#include "reactor.hpp"
+#include "rate.hpp"
+
+// A logical stream. It starts suspended and runs on the FReactor thread it
+// is added to; it must outlive the reactor threads.
+struct FCoro : FReactorTask
+{
+    struct promise_type
+    {
+        // what a parked coroutine is waiting for, see FAwaiter
+        void * waiting = nullptr;
+        bool (*waiting_ready)(void *) = nullptr;
+
+        FCoro get_return_object() { return FCoro(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    explicit FCoro(std::coroutine_handle<promise_type> handle)
+    : handle(handle)
+    {}
+
+    FCoro(FCoro && other) noexcept
+    : handle(std::exchange(other.handle, nullptr))
+    {}
+
+    FCoro(const FCoro &) = delete;
+    FCoro & operator=(const FCoro &) = delete;
+
+    ~FCoro()
+    {
+        if (handle) handle.destroy();
+    }
+
+    // resumes the coroutine if what it waits for is ready
+    bool try_step()
+    {
+        if (handle.done()) return false;
+        promise_type & p = handle.promise();
+        if (p.waiting and !p.waiting_ready(p.waiting)) return false;
+        p.waiting = nullptr;
+        handle.resume();
+        return true;
+    }
+
+    bool done() const { return handle.done(); }
+};
+
+
+// Suspends the coroutine until Derived::ready() returns true. ready() is
+// called by await_ready and then by the reactor, and must only return true
+// once. The reactor calls it through a plain function pointer (CRTP), an
+// awaiter has no vtable.
+template <typename Derived>
+struct FAwaiter
+{
+    bool await_ready() { return derived().ready(); }
+
+    void await_suspend(std::coroutine_handle<FCoro::promise_type> h)
+    {
+        h.promise().waiting = &derived();
+        h.promise().waiting_ready = [](void * d) { return static_cast<Derived *>(d)->ready(); };
+    }
+
+private:
+
+    Derived & derived() { return static_cast<Derived &>(*this); }
+};
+
+
+template <typename Pipe>
+struct FGetBatchAwaiter : FAwaiter< FGetBatchAwaiter<Pipe> >
+{
+    Pipe & pipe;
+    size_t rid;
+
+    FGetBatchAwaiter(Pipe & pipe, const size_t rid) : pipe(pipe), rid(rid) {}
+
+    bool ready() { return pipe.source_poll(rid); }
+    auto await_resume() { return pipe.get_batch(rid); }
+};
+
+// a free batch of source replica `rid`
+template <typename Pipe>
+FGetBatchAwaiter<Pipe> f_get_batch(Pipe & pipe, const size_t rid)
+{
+    return FGetBatchAwaiter<Pipe>(pipe, rid);
+}
+
+
+template <typename Pipe, typename T>
+struct FPushAwaiter : FAwaiter< FPushAwaiter<Pipe, T> >
+{
+    Pipe & pipe;
+    T * batch;
+    size_t batch_size;
+    size_t rid;
+    bool last;
+
+    FPushAwaiter(Pipe & pipe, T * batch, const size_t batch_size, const size_t rid, const bool last)
+    : pipe(pipe), batch(batch), batch_size(batch_size), rid(rid), last(last) {}
+
+    // push only enqueues (COPY, HYBRID) or publishes a header (SHARED)
+    bool ready() { return true; }
+    void await_resume() { pipe.push(batch, batch_size, rid, last); }
+};
+
+template <typename Pipe, typename T>
+FPushAwaiter<Pipe, T> f_push(Pipe & pipe, T * batch, const size_t batch_size, const size_t rid, const bool last = false)
+{
+    return FPushAwaiter<Pipe, T>(pipe, batch, batch_size, rid, last);
+}
+
+
+template <typename T>
+struct FPopResult
+{
+    T * batch;
+    size_t received;
+    bool last;
+};
+
+template <typename Pipe>
+struct FPopAwaiter : FAwaiter< FPopAwaiter<Pipe> >
+{
+    Pipe & pipe;
+    size_t rid;
+    size_t batch_size;
+
+    FPopAwaiter(Pipe & pipe, const size_t rid, const size_t batch_size) : pipe(pipe), rid(rid), batch_size(batch_size) {}
+
+    bool ready() { return pipe.sink_poll(rid, batch_size); }
+
+    auto await_resume()
+    {
+        size_t received = 0;
+        bool last = false;
+        auto * batch = pipe.pop(rid, batch_size, &received, &last);
+        return FPopResult< typename std::remove_pointer<decltype(batch)>::type >{batch, received, last};
+    }
+};
+
+// the next batch of sink replica `rid`, with the number of tuples and the
+// end of stream flag
+template <typename Pipe>
+FPopAwaiter<Pipe> f_pop(Pipe & pipe, const size_t rid, const size_t batch_size)
+{
+    return FPopAwaiter<Pipe>(pipe, rid, batch_size);
+}
+
+
+template <typename Pipe, typename T>
+struct FPutBatchAwaiter : FAwaiter< FPutBatchAwaiter<Pipe, T> >
+{
+    Pipe & pipe;
+    size_t rid;
+    T * batch;
+
+    FPutBatchAwaiter(Pipe & pipe, const size_t rid, T * batch) : pipe(pipe), rid(rid), batch(batch) {}
+
+    bool ready() { return true; }
+    void await_resume() { pipe.put_batch(rid, batch); }
+};
+
+template <typename Pipe, typename T>
+FPutBatchAwaiter<Pipe, T> f_put_batch(Pipe & pipe, const size_t rid, T * batch)
+{
+    return FPutBatchAwaiter<Pipe, T>(pipe, rid, batch);
+}
+
+
+// a batch of `n` tuples may be released by `pacer` (see FRatePacer)
+struct FPacedAwaiter : FAwaiter<FPacedAwaiter>
+{
+    FRatePacer & pacer;
+    size_t n;
+
+    FPacedAwaiter(FRatePacer & pacer, const size_t n) : pacer(pacer), n(n) {}
+
+    bool ready() { return pacer.try_take(n); }
+    void await_resume() {}
+};
+
+inline FPacedAwaiter f_paced(FRatePacer & pacer, const size_t n)
+{
+    return FPacedAwaiter(pacer, n);
+}
+
+
+// lets the other coroutines of the reactor thread run once
+struct FYieldAwaiter : FAwaiter<FYieldAwaiter>
+{
+    bool polled = false;
+
+    bool ready()
+    {
+        const bool r = polled;
+        polled = true;
+        return r;
+    }
+    void await_resume() {}
+};
+
+inline FYieldAwaiter f_yield()
+{
+    return FYieldAwaiter();
+}
+
+#else
+
+#define F_COROUTINES 0
+
+#endif
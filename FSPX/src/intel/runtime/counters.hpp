@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+#include "utils.hpp"
+
+#ifndef F_CACHE_LINE_SIZE
+#define F_CACHE_LINE_SIZE 64
+#endif
+
+// Statistics of one source or sink thread. Only the owner thread writes
+// them, with a relaxed load and store (no locked read-modify-write), while
+// any thread can read them at any time. Each block starts on its own cache
+// line, so replicas never write to the same line.
+struct alignas(F_CACHE_LINE_SIZE) FReplicaCounters
+{
+    std::atomic<uint64_t> tuples;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> wait_ns;     // time spent blocked in get_batch (sources) or pop (sinks)
+
+    FReplicaCounters()
+    : tuples(0)
+    , batches(0)
+    , wait_ns(0)
+    {}
+
+    // one batch of `n` tuples, after waiting `wait` ns for it
+    ALWAYS_INLINE void add(const uint64_t n,
+                           const uint64_t wait)
+    {
+        tuples.store(tuples.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        batches.store(batches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        wait_ns.store(wait_ns.load(std::memory_order_relaxed) + wait, std::memory_order_relaxed);
+    }
+};
+
+
+// Backpressure of one source replica, written only by the thread that gets
+// its batches: time blocked waiting for one of the N buffers to be released
+// by the device, and non-blocking attempts that found all N in flight.
+struct alignas(F_CACHE_LINE_SIZE) FBackpressureCounters
+{
+    std::atomic<uint64_t> blocked_ns;
+    std::atomic<uint64_t> full_polls;
+
+    FBackpressureCounters()
+    : blocked_ns(0)
+    , full_polls(0)
+    {}
+
+    ALWAYS_INLINE void add_blocked(const uint64_t ns)
+    {
+        blocked_ns.store(blocked_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    }
+
+    ALWAYS_INLINE void add_full_poll()
+    {
+        full_polls.store(full_polls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+
+// `n` cache-aligned blocks, one per replica
+template <typename C>
+C * f_new_blocks(const size_t n)
+{
+    C * blocks = static_cast<C *>(f_alloc_bytes(n * sizeof(C), FAllocPolicy::DEFAULT));
+    for (size_t rid = 0; rid < n; ++rid) {
+        new (blocks + rid) C();
+    }
+    return blocks;
+}
+
+template <typename C>
+void f_delete_blocks(C * blocks, const size_t n)
+{
+    for (size_t rid = 0; rid < n; ++rid) {
+        blocks[rid].~C();
+    }
+    f_free(blocks);
+}
+
+
+// One FReplicaCounters per replica, the totals are the sum of the relaxed
+// loads of every block (readers never write, writers never synchronize).
+struct FCounters
+{
+    size_t replicas;
+    FReplicaCounters * blocks;
+
+    FCounters(const size_t replicas)
+    : replicas(replicas)
+    , blocks(f_new_blocks<FReplicaCounters>(replicas))
+    {}
+
+    FCounters(const FCounters &) = delete;
+    FCounters & operator=(const FCounters &) = delete;
+
+    ~FCounters()
+    {
+        f_delete_blocks(blocks, replicas);
+    }
+
+    FReplicaCounters & operator[](const size_t rid) { return blocks[rid]; }
+
+    uint64_t tuples() const  { return sum(&FReplicaCounters::tuples); }
+    uint64_t batches() const { return sum(&FReplicaCounters::batches); }
+    uint64_t wait_ns() const { return sum(&FReplicaCounters::wait_ns); }
+
+private:
+
+    uint64_t sum(std::atomic<uint64_t> FReplicaCounters::* field) const
+    {
+        uint64_t total = 0;
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            total += (blocks[rid].*field).load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+};
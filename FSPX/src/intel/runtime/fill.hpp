@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstring>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "utils.hpp"
+
+// Batches of at least FILL_STREAM_THRESHOLD bytes are written with
+// non-temporal stores (where available): they are read back by the DMA or
+// by the device, not by the host, so caching them only evicts the dataset.
+#ifndef FILL_STREAM_THRESHOLD
+#define FILL_STREAM_THRESHOLD (64 * 1024)
+#endif
+
+
+ALWAYS_INLINE void f_stream_copy(void * dst,
+                                 const void * src,
+                                 const size_t bytes)
+{
+#if defined(__SSE2__)
+    if (bytes >= FILL_STREAM_THRESHOLD and (reinterpret_cast<uintptr_t>(dst) & 15) == 0) {
+        __m128i * d = static_cast<__m128i *>(dst);
+        const __m128i * s = static_cast<const __m128i *>(src);
+        const size_t n = bytes / sizeof(__m128i);
+        for (size_t i = 0; i < n; ++i) {
+            _mm_stream_si128(d + i, _mm_loadu_si128(s + i));
+        }
+        _mm_sfence();
+        memcpy(d + n, s + n, bytes - n * sizeof(__m128i));
+        return;
+    }
+#endif
+    memcpy(dst, src, bytes);
+}
+
+// Copies `n` tuples of `tuple_bytes` bytes overwriting the 32-bit word at
+// `ts_offset` of each tuple with `ts`. Tuples are processed in groups that
+// span lcm(tuple_bytes, 16) bytes: inside a group the timestamps fall at the
+// same lanes, so each 16-byte vector is stamped with a precomputed mask
+// between load and store, with no extra pass over the batch.
+#define FILL_STAMP_MAX_VECTORS 8
+
+inline void f_copy_stamp(void * dst,
+                         const void * src,
+                         const size_t n,
+                         const size_t tuple_bytes,
+                         const size_t ts_offset,
+                         const uint32_t ts)
+{
+    uint8_t * d = static_cast<uint8_t *>(dst);
+    const uint8_t * s = static_cast<const uint8_t *>(src);
+    size_t done = 0;
+
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const size_t pow2 = std::min<size_t>(tuple_bytes & (~tuple_bytes + 1), 16);
+    const size_t group_vectors = tuple_bytes / pow2;
+    const size_t group_tuples = 16 / pow2;
+
+    if (tuple_bytes % 4 == 0 and ts_offset % 4 == 0 and group_vectors <= FILL_STAMP_MAX_VECTORS) {
+        uint32_t masks[FILL_STAMP_MAX_VECTORS][4] = {};
+        for (size_t t = 0; t < group_tuples; ++t) {
+            const size_t w = (t * tuple_bytes + ts_offset) / 4;
+            masks[w / 4][w % 4] = ~0u;
+        }
+
+        const size_t groups = n / group_tuples;
+        const size_t group_bytes = group_vectors * 16;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+        uint32x4_t m[FILL_STAMP_MAX_VECTORS];
+        for (size_t v = 0; v < group_vectors; ++v) m[v] = vld1q_u32(masks[v]);
+        const uint32x4_t tsv = vdupq_n_u32(ts);
+        for (size_t g = 0; g < groups; ++g) {
+            const uint32_t * gs = reinterpret_cast<const uint32_t *>(s + g * group_bytes);
+            uint32_t * gd = reinterpret_cast<uint32_t *>(d + g * group_bytes);
+            for (size_t v = 0; v < group_vectors; ++v) {
+                vst1q_u32(gd + 4 * v, vbslq_u32(m[v], tsv, vld1q_u32(gs + 4 * v)));
+            }
+        }
+#else
+        __m128i m[FILL_STAMP_MAX_VECTORS];
+        for (size_t v = 0; v < group_vectors; ++v) m[v] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks[v]));
+        const __m128i tsv = _mm_set1_epi32(static_cast<int>(ts));
+        for (size_t g = 0; g < groups; ++g) {
+            const __m128i * gs = reinterpret_cast<const __m128i *>(s + g * group_bytes);
+            __m128i * gd = reinterpret_cast<__m128i *>(d + g * group_bytes);
+            for (size_t v = 0; v < group_vectors; ++v) {
+                const __m128i x = _mm_loadu_si128(gs + v);
+                _mm_storeu_si128(gd + v, _mm_or_si128(_mm_andnot_si128(m[v], x), _mm_and_si128(m[v], tsv)));
+            }
+        }
+#endif
+        done = groups * group_tuples;
+    }
+#endif
+
+    // tail (or no SIMD): copy, then stamp
+    memcpy(d + done * tuple_bytes, s + done * tuple_bytes, (n - done) * tuple_bytes);
+    for (size_t i = done; i < n; ++i) {
+        memcpy(d + i * tuple_bytes + ts_offset, &ts, sizeof(ts));
+    }
+}
+
+
+// The dataset replicated into a ring of `period + max_batch_size` tuples,
+// where `period` is a multiple of the dataset size not smaller than
+// `max_batch_size`. Every batch is then one contiguous span of the ring:
+// the fill is a single copy and the cursor wraps at most once per batch
+// (one compare) instead of a modulo per tuple.
+template <typename T>
+struct FDatasetRing
+{
+    size_t dataset_size;
+    size_t max_batch_size;
+    size_t period;
+    T * data;
+
+    FDatasetRing(const T * dataset,
+                 const size_t dataset_size,
+                 const size_t max_batch_size)
+    : dataset_size(dataset_size)
+    , max_batch_size(max_batch_size)
+    , period(round_up(max_batch_size, dataset_size))
+    , data(f_alloc<T>(period + max_batch_size))
+    {
+        for (size_t i = 0; i < period + max_batch_size; i += dataset_size) {
+            const size_t n = std::min(dataset_size, period + max_batch_size - i);
+            memcpy(data + i, dataset, n * sizeof(T));
+        }
+    }
+
+    FDatasetRing(const FDatasetRing &) = delete;
+    FDatasetRing & operator=(const FDatasetRing &) = delete;
+
+    ~FDatasetRing() { f_free(data); }
+
+    ALWAYS_INLINE void advance(size_t & idx, const size_t n) const
+    {
+        idx += n;
+        if (idx >= period) idx -= period;
+    }
+
+    // copies the next `n` (<= max_batch_size) tuples starting at `idx`
+    void fill(T * batch,
+              const size_t n,
+              size_t & idx) const
+    {
+        f_stream_copy(batch, data + idx, n * sizeof(T));
+        advance(idx, n);
+    }
+
+    // as fill, and sets the `timestamp` field of each tuple to `ts`
+    void fill_stamped(T * batch,
+                      const size_t n,
+                      size_t & idx,
+                      const uint32_t ts) const
+    {
+        static_assert(sizeof(batch->timestamp) == sizeof(ts), "FDatasetRing: timestamp must be 32-bit");
+        f_copy_stamp(batch, data + idx, n, sizeof(T), offsetof(T, timestamp), ts);
+        advance(idx, n);
+    }
+};
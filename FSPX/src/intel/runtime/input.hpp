@@ -0,0 +1,781 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "utils.hpp"
+#include "counters.hpp"
+#include "fill.hpp"
+#include "latency.hpp"
+
+// Input sources of the source replicas. Every source writes the tuples of a
+// batch straight into the batch of the pipe (one copy from memory, a mapped
+// file or the socket buffer, none for the generator) and stamps them in the
+// same pass when latency is measured.
+
+// The timestamp written into every tuple, at `offset` bytes (see f_copy_stamp).
+// `ts` is taken when the fill starts; an input that waits for its tuples
+// (a socket) stamps them once they arrived, from `epoch_ns`.
+struct FInputStamp
+{
+    size_t offset;
+    uint32_t ts;
+    uint64_t epoch_ns;
+};
+
+template <typename T>
+ALWAYS_INLINE void f_stamp(T * batch,
+                           const size_t n,
+                           const FInputStamp * stamp)
+{
+    if (!stamp) return;
+    uint8_t * b = reinterpret_cast<uint8_t *>(batch) + stamp->offset;
+    for (size_t i = 0; i < n; ++i) {
+        memcpy(b + i * sizeof(T), &stamp->ts, sizeof(stamp->ts));
+    }
+}
+
+// copies `n` tuples, stamped if `stamp` is set
+template <typename T>
+ALWAYS_INLINE void f_copy_tuples(T * dst,
+                                 const T * src,
+                                 const size_t n,
+                                 const FInputStamp * stamp)
+{
+    if (stamp) {
+        f_copy_stamp(dst, src, n, sizeof(T), stamp->offset, stamp->ts);
+    } else {
+        f_stream_copy(dst, src, n * sizeof(T));
+    }
+}
+
+
+template <typename T>
+struct FInput
+{
+    virtual ~FInput() {}
+
+    // writes the next `n` tuples of replica `rid` into `batch`, stamped if
+    // `stamp` is set; returns n, or less once the input ended
+    virtual size_t fill(T * batch,
+                        const size_t n,
+                        const size_t rid,
+                        const FInputStamp * stamp) = 0;
+
+    // fill for the reactor, that never blocks: false while the tuples are
+    // still arriving, to be called again with the same batch; true once
+    // `*filled` tuples are in the batch, as fill would return
+    virtual bool try_fill(T * batch,
+                          const size_t n,
+                          const size_t rid,
+                          const FInputStamp * stamp,
+                          size_t * filled)
+    {
+        *filled = fill(batch, n, rid, stamp);
+        return true;
+    }
+
+    // back to the first tuple, before a run (not for streams)
+    virtual void rewind() {}
+};
+
+
+// Position of a replica in its input, written only by its thread
+struct alignas(F_CACHE_LINE_SIZE) FInputCursor
+{
+    size_t idx;
+    uint64_t rng;
+
+    FInputCursor()
+    : idx(0)
+    , rng(0)
+    {}
+};
+
+
+// In-memory replay of a dataset, in a loop (see FDatasetRing)
+template <typename T>
+struct FReplayInput : FInput<T>
+{
+    FDatasetRing<T> ring;
+    size_t replicas;
+    FInputCursor * cursors;
+
+    FReplayInput(const T * dataset,
+                 const size_t dataset_size,
+                 const size_t max_batch_size,
+                 const size_t replicas)
+    : ring(dataset, dataset_size, max_batch_size)
+    , replicas(replicas)
+    , cursors(f_new_blocks<FInputCursor>(replicas))
+    {}
+
+    ~FReplayInput() { f_delete_blocks(cursors, replicas); }
+
+    void rewind()
+    {
+        for (size_t rid = 0; rid < replicas; ++rid) cursors[rid].idx = 0;
+    }
+
+    size_t fill(T * batch,
+                const size_t n,
+                const size_t rid,
+                const FInputStamp * stamp)
+    {
+        size_t & idx = cursors[rid].idx;
+        f_copy_tuples(batch, ring.data + idx, n, stamp);
+        ring.advance(idx, n);
+        return n;
+    }
+};
+
+
+// A binary file of raw T records, mapped read-only and replayed in a loop:
+// the file is paged in on demand instead of being loaded up front
+template <typename T>
+struct FMmapInput : FInput<T>
+{
+    const T * records;
+    size_t records_n;
+    size_t bytes;
+    size_t replicas;
+    FInputCursor * cursors;
+
+    FMmapInput(const std::string & filepath,
+               const size_t replicas)
+    : records(nullptr)
+    , records_n(0)
+    , bytes(0)
+    , replicas(replicas)
+    , cursors(f_new_blocks<FInputCursor>(replicas))
+    {
+        const int fd = open(filepath.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 or fstat(fd, &st) != 0) {
+            std::cout << "ERROR: FMmapInput: cannot open " << filepath << "!\n";
+            exit(-1);
+        }
+        bytes = st.st_size;
+        records_n = bytes / sizeof(T);
+        if (records_n == 0 or bytes % sizeof(T) != 0) {
+            std::cout << "ERROR: FMmapInput: " << filepath << " is not a file of "
+                      << sizeof(T) << "-byte records!\n";
+            exit(-1);
+        }
+        void * p = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            std::cout << "ERROR: FMmapInput: cannot map " << filepath << "!\n";
+            exit(-1);
+        }
+        madvise(p, bytes, MADV_SEQUENTIAL);
+        records = static_cast<const T *>(p);
+    }
+
+    FMmapInput(const FMmapInput &) = delete;
+    FMmapInput & operator=(const FMmapInput &) = delete;
+
+    ~FMmapInput()
+    {
+        munmap(const_cast<T *>(records), bytes);
+        f_delete_blocks(cursors, replicas);
+    }
+
+    void rewind()
+    {
+        for (size_t rid = 0; rid < replicas; ++rid) cursors[rid].idx = 0;
+    }
+
+    // one copy per contiguous span, at most two per batch unless the
+    // file is smaller than a batch
+    size_t fill(T * batch,
+                const size_t n,
+                const size_t rid,
+                const FInputStamp * stamp)
+    {
+        size_t & idx = cursors[rid].idx;
+        size_t done = 0;
+        while (done < n) {
+            const size_t span = std::min(n - done, records_n - idx);
+            f_copy_tuples(batch + done, records + idx, span, stamp);
+            done += span;
+            idx += span;
+            if (idx == records_n) idx = 0;
+        }
+        return n;
+    }
+};
+
+// writes `n` records as the raw binary file read by FMmapInput
+template <typename T>
+bool f_save_records(const std::string & filepath,
+                    const T * records,
+                    const size_t n)
+{
+    FILE * file = fopen(filepath.c_str(), "wb");
+    if (!file) return false;
+    const bool ok = (fwrite(records, sizeof(T), n, file) == n);
+    return (fclose(file) == 0) and ok;
+}
+
+// loads a raw binary file of T records
+template <typename T>
+f_vector<T> f_load_records(const std::string & filepath)
+{
+    f_vector<T> records;
+    FILE * file = fopen(filepath.c_str(), "rb");
+    if (!file) return records;
+    fseek(file, 0, SEEK_END);
+    const long bytes = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    records.resize(bytes > 0 ? bytes / sizeof(T) : 0);
+    if (fread(records.data(), sizeof(T), records.size(), file) != records.size()) {
+        records.clear();
+    }
+    fclose(file);
+    return records;
+}
+
+
+// xorshift64*, one state per replica
+ALWAYS_INLINE uint64_t f_rand_next(uint64_t & s)
+{
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 0x2545F4914F6CDD1DULL;
+}
+
+// splitmix64 of `seed`, never 0 (a valid xorshift state)
+inline uint64_t f_rand_seed(uint64_t seed)
+{
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    seed ^= seed >> 31;
+    return seed ? seed : 1;
+}
+
+
+// Vose's alias method: a draw from `weights` is one random word, whatever
+// the skew. The high 32 bits pick a bucket, the low 32 bits its coin.
+struct FAliasTable
+{
+    struct Entry
+    {
+        uint32_t prob;  // threshold of the coin
+        uint32_t alias;
+    };
+
+    std::vector<Entry> entries;
+
+    FAliasTable() {}
+
+    FAliasTable(const std::vector<double> & weights)
+    {
+        const uint32_t n = static_cast<uint32_t>(weights.size());
+        double sum = 0;
+        for (auto w : weights) sum += w;
+
+        std::vector<double> p(n);
+        std::vector<uint32_t> small, large;
+        for (uint32_t k = 0; k < n; ++k) {
+            p[k] = (sum > 0) ? weights[k] * n / sum : 1.0;
+            (p[k] < 1.0 ? small : large).push_back(k);
+        }
+
+        // a bucket that keeps its coin is never aliased (alias to itself)
+        entries.resize(n);
+        for (uint32_t k = 0; k < n; ++k) entries[k] = {UINT32_MAX, k};
+        while (!small.empty() and !large.empty()) {
+            const uint32_t l = small.back(); small.pop_back();
+            const uint32_t g = large.back(); large.pop_back();
+            entries[l] = {static_cast<uint32_t>(p[l] * 4294967296.0), g};
+            p[g] -= 1.0 - p[l];
+            (p[g] < 1.0 ? small : large).push_back(g);
+        }
+    }
+
+    size_t size() const { return entries.size(); }
+
+    ALWAYS_INLINE uint32_t sample(const uint64_t r) const
+    {
+        const uint32_t bucket = static_cast<uint32_t>(((r >> 32) * entries.size()) >> 32);
+        const Entry e = entries[bucket];
+        return (static_cast<uint32_t>(r) < e.prob) ? bucket : e.alias;
+    }
+};
+
+
+// Keys in [0, keys), uniform or Zipf(s) (key 0 the most frequent)
+struct FKeyDistribution
+{
+    uint32_t keys;
+    double s;
+    FAliasTable zipf;   // empty if uniform
+
+    FKeyDistribution(const uint32_t keys,
+                     const double s = 0)
+    : keys(std::max<uint32_t>(1, keys))
+    , s(s)
+    {
+        if (s <= 0) return;
+        std::vector<double> weights(this->keys);
+        for (uint32_t k = 0; k < this->keys; ++k) {
+            weights[k] = 1.0 / std::pow(k + 1.0, s);
+        }
+        zipf = FAliasTable(weights);
+    }
+
+    ALWAYS_INLINE uint32_t next(uint64_t & rng) const
+    {
+        const uint64_t r = f_rand_next(rng);
+        if (zipf.size() == 0) return static_cast<uint32_t>(((r >> 32) * keys) >> 32);
+        return zipf.sample(r);
+    }
+};
+
+// sets t.key where the tuple has one
+template <typename T>
+ALWAYS_INLINE auto f_set_key(T & t, const uint32_t key, int) -> decltype(t.key = key, void())
+{
+    t.key = key;
+}
+
+template <typename T>
+ALWAYS_INLINE void f_set_key(T &, const uint32_t, long) {}
+
+
+// Synthetic tuples: the values of `values` in a loop, each with a key drawn
+// from `keys`. Tuples are built in the batch, there is no source to copy.
+template <typename T>
+struct FGeneratorInput : FInput<T>
+{
+    f_vector<T> values;
+    FKeyDistribution keys;
+    size_t replicas;
+    uint64_t seed;
+    FInputCursor * cursors;
+
+    FGeneratorInput(const T * values,
+                    const size_t values_n,
+                    const FKeyDistribution & keys,
+                    const size_t replicas,
+                    const uint64_t seed = 1)
+    : values(values, values + values_n)
+    , keys(keys)
+    , replicas(replicas)
+    , seed(seed)
+    , cursors(f_new_blocks<FInputCursor>(replicas))
+    {
+        if (this->values.empty()) this->values.resize(1);
+        rewind();
+    }
+
+    ~FGeneratorInput() { f_delete_blocks(cursors, replicas); }
+
+    // the same keys in every run
+    void rewind()
+    {
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            cursors[rid].idx = 0;
+            cursors[rid].rng = f_rand_seed(seed + rid);
+        }
+    }
+
+    size_t fill(T * batch,
+                const size_t n,
+                const size_t rid,
+                const FInputStamp * stamp)
+    {
+        FInputCursor & c = cursors[rid];
+        for (size_t i = 0; i < n; ++i) {
+            T t = values[c.idx];
+            f_set_key(t, keys.next(c.rng), 0);
+            batch[i] = t;
+            if (++c.idx == values.size()) c.idx = 0;
+        }
+        f_stamp(batch, n, stamp);
+        return n;
+    }
+};
+
+
+inline bool f_valid_socket_endpoint(const std::string & endpoint)
+{
+    if (endpoint.compare(0, 4, "tcp:") == 0) return atoi(endpoint.c_str() + 4) > 0;
+    if (endpoint.compare(0, 5, "unix:") == 0) return endpoint.size() > 5;
+    return false;
+}
+
+// Raw T records read from local stream sockets, one connection per replica
+// (tcp:PORT on the loopback, or unix:PATH). recv writes into the batch, so
+// the kernel socket buffer is the only other copy. A connection is accepted
+// by the first fill of its replica; the input of a replica ends when its
+// producer closes the connection. With `feed` set, stand-in producers stream
+// `feed` in a loop to every replica until the input is destroyed.
+// try_fill accepts and receives without blocking, a batch is completed over
+// several calls (the bytes received so far are the cursor of the replica).
+// Tuples are stamped once the whole batch arrived.
+template <typename T>
+struct FSocketInput : FInput<T>
+{
+    std::string endpoint;
+    size_t replicas;
+    int listen_fd;
+    std::vector<int> fds;
+    FInputCursor * cursors;
+    std::vector<std::thread> feeders;
+    std::atomic<bool> stop_flag;
+
+    FSocketInput(const std::string & endpoint,
+                 const size_t replicas,
+                 const T * feed = nullptr,
+                 const size_t feed_n = 0)
+    : endpoint(endpoint)
+    , replicas(replicas)
+    , listen_fd(-1)
+    , fds(replicas, -1)
+    , cursors(f_new_blocks<FInputCursor>(replicas))
+    , stop_flag(false)
+    {
+        // non-blocking, as replicas served by different reactor threads may
+        // race for the same pending connection
+        listen_fd = open_socket();
+        if (listen_fd < 0 or bind_endpoint(listen_fd) != 0 or listen(listen_fd, replicas) != 0
+            or fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK) != 0) {
+            std::cout << "ERROR: FSocketInput: cannot listen on " << endpoint << "!\n";
+            exit(-1);
+        }
+        std::cout << "FSocketInput: waiting for " << replicas << " producer(s) on " << endpoint << std::endl;
+
+        if (feed and feed_n > 0) {
+            for (size_t rid = 0; rid < replicas; ++rid) {
+                feeders.emplace_back(&FSocketInput::feed_loop, this, feed, feed_n);
+            }
+        }
+    }
+
+    FSocketInput(const FSocketInput &) = delete;
+    FSocketInput & operator=(const FSocketInput &) = delete;
+
+    ~FSocketInput()
+    {
+        // closing the connections unblocks the feeders stuck in send
+        stop_flag = true;
+        for (auto fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+        if (listen_fd >= 0) {
+            shutdown(listen_fd, SHUT_RDWR);
+            close(listen_fd);
+        }
+        for (auto & t : feeders) t.join();
+        f_delete_blocks(cursors, replicas);
+        if (is_unix()) unlink(endpoint.c_str() + 5);
+    }
+
+    size_t fill(T * batch,
+                const size_t n,
+                const size_t rid,
+                const FInputStamp * stamp)
+    {
+        size_t filled = 0;
+        while (!receive(batch, n, rid, stamp, true, &filled)) {}
+        return filled;
+    }
+
+    bool try_fill(T * batch,
+                  const size_t n,
+                  const size_t rid,
+                  const FInputStamp * stamp,
+                  size_t * filled)
+    {
+        return receive(batch, n, rid, stamp, false, filled);
+    }
+
+private:
+
+    // the connection of replica `rid`, -1 while none is pending (or on error,
+    // with `*failed` set)
+    int connection(const size_t rid,
+                   const bool block,
+                   bool * failed)
+    {
+        *failed = false;
+        while (fds[rid] < 0) {
+            if (block) {
+                struct pollfd p = {listen_fd, POLLIN, 0};
+                if (poll(&p, 1, -1) < 0 and errno != EINTR) break;
+            }
+            fds[rid] = accept(listen_fd, NULL, NULL);
+            if (fds[rid] >= 0) break;
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN and errno != EWOULDBLOCK) break;
+            if (!block) return -1;
+        }
+        *failed = (fds[rid] < 0);
+        return fds[rid];
+    }
+
+    // receives the rest of the batch of replica `rid`; true once it is
+    // complete or the input ended, with `*filled` tuples
+    bool receive(T * batch,
+                 const size_t n,
+                 const size_t rid,
+                 const FInputStamp * stamp,
+                 const bool block,
+                 size_t * filled)
+    {
+        size_t & got = cursors[rid].idx;
+        bool failed = false;
+        const int fd = connection(rid, block, &failed);
+        if (fd < 0) {
+            *filled = 0;
+            return failed;
+        }
+
+        uint8_t * dst = reinterpret_cast<uint8_t *>(batch);
+        const size_t bytes = n * sizeof(T);
+        while (got < bytes) {
+            const ssize_t r = recv(fd, dst + got, bytes - got, block ? MSG_WAITALL : MSG_DONTWAIT);
+            if (r > 0) {
+                got += r;
+            } else if (r < 0 and errno == EINTR) {
+                continue;
+            } else if (r < 0 and !block and (errno == EAGAIN or errno == EWOULDBLOCK)) {
+                return false;
+            } else {
+                break;  // closed by the producer: a partial record is dropped
+            }
+        }
+
+        *filled = got / sizeof(T);
+        got = 0;
+        if (stamp) {
+            const FInputStamp arrived = {stamp->offset, f_latency_stamp(stamp->epoch_ns), stamp->epoch_ns};
+            f_stamp(batch, *filled, &arrived);
+        }
+        return true;
+    }
+
+    bool is_unix() const { return endpoint.compare(0, 5, "unix:") == 0; }
+
+    int open_socket() const
+    {
+        return socket(is_unix() ? AF_UNIX : AF_INET, SOCK_STREAM, 0);
+    }
+
+    int bind_endpoint(const int fd) const
+    {
+        if (is_unix()) {
+            struct sockaddr_un addr;
+            make_unix_addr(addr);
+            unlink(addr.sun_path);
+            return bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+        }
+        const int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr;
+        make_tcp_addr(addr);
+        return bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    }
+
+    int connect_endpoint(const int fd) const
+    {
+        if (is_unix()) {
+            struct sockaddr_un addr;
+            make_unix_addr(addr);
+            return connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+        }
+        struct sockaddr_in addr;
+        make_tcp_addr(addr);
+        return connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    }
+
+    void make_unix_addr(struct sockaddr_un & addr) const
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, endpoint.c_str() + 5, sizeof(addr.sun_path) - 1);
+    }
+
+    void make_tcp_addr(struct sockaddr_in & addr) const
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(atoi(endpoint.c_str() + 4));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+
+    // stand-in producer: streams `feed` in a loop until the input is closed
+    void feed_loop(const T * feed,
+                   const size_t feed_n)
+    {
+        const int fd = open_socket();
+        if (fd < 0 or connect_endpoint(fd) != 0) {
+            std::cout << "FSocketInput: the stand-in producer cannot connect to " << endpoint << std::endl;
+            if (fd >= 0) close(fd);
+            return;
+        }
+        const uint8_t * src = reinterpret_cast<const uint8_t *>(feed);
+        const size_t bytes = feed_n * sizeof(T);
+        size_t sent = 0;
+        while (!stop_flag) {
+            const ssize_t r = send(fd, src + sent, bytes - sent, MSG_NOSIGNAL);
+            if (r < 0 and errno == EINTR) continue;
+            if (r <= 0) break;
+            sent += r;
+            if (sent == bytes) sent = 0;
+        }
+        close(fd);
+    }
+};
+
+
+enum class FInputKind { REPLAY, MMAP, UNIFORM, ZIPF, SOCKET, WORKLOAD };
+
+// Input of the source replicas, from a string:
+//   replay                          the dataset, from memory (default)
+//   mmap:PATH                       a raw binary file of records (written from
+//                                   the dataset if it does not exist)
+//   uniform:KEYS, zipf:KEYS,S       the dataset values with synthetic keys
+//   tcp:PORT[,local]                records from local producers, `local`
+//   unix:PATH[,local]               starts stand-ins fed by the dataset
+//   workload:KEYS,S[,P...]          the synthetic workload of the application
+//                                   (S = 0 for uniform keys, see workload.hpp)
+struct FInputSpec
+{
+    FInputKind kind;
+    std::string path;       // file (MMAP) or endpoint (SOCKET)
+    uint32_t keys;
+    double s;
+    bool local;
+    std::vector<double> params; // of the workload
+
+    FInputSpec()
+    : kind(FInputKind::REPLAY)
+    , keys(0)
+    , s(0)
+    , local(false)
+    {}
+
+    bool parse(const std::string & str)
+    {
+        const size_t colon = str.find(':');
+        const std::string name = str.substr(0, colon);
+        const std::string args = (colon != std::string::npos) ? str.substr(colon + 1) : "";
+
+        path.clear();
+        keys = 0;
+        s = 0;
+        local = false;
+        params.clear();
+
+        if (name.compare("replay") == 0) {
+            kind = FInputKind::REPLAY;
+            return args.empty();
+        }
+        if (name.compare("mmap") == 0) {
+            kind = FInputKind::MMAP;
+            path = args;
+            return !path.empty();
+        }
+        if (name.compare("uniform") == 0 or name.compare("zipf") == 0) {
+            kind = (name.compare("zipf") == 0) ? FInputKind::ZIPF : FInputKind::UNIFORM;
+            std::stringstream ss(args);
+            char comma = 0;
+            if (!(ss >> keys) or keys == 0) return false;
+            if (kind == FInputKind::UNIFORM) return ss.eof();
+            return (ss >> comma >> s) and comma == ',' and s > 0;
+        }
+        if (name.compare("tcp") == 0 or name.compare("unix") == 0) {
+            kind = FInputKind::SOCKET;
+            path = str;
+            const size_t comma = path.rfind(',');
+            if (comma != std::string::npos and path.compare(comma, std::string::npos, ",local") == 0) {
+                local = true;
+                path.erase(comma);
+            }
+            return f_valid_socket_endpoint(path);
+        }
+        if (name.compare("workload") == 0) {
+            kind = FInputKind::WORKLOAD;
+            std::stringstream ss(args);
+            char comma = 0;
+            if (!(ss >> keys) or keys == 0) return false;
+            if (!(ss >> comma >> s) or comma != ',' or s < 0) return false;
+            for (double v; ss >> comma >> v;) {
+                if (comma != ',') return false;
+                params.push_back(v);
+            }
+            return ss.eof();
+        }
+        return false;
+    }
+};
+
+// the input of `spec` over `dataset` (values, mmap file contents, stand-in
+// producers) for `replicas` sources filling batches of up to `max_batch_size`
+template <typename T>
+std::unique_ptr< FInput<T> > f_make_input(const FInputSpec & spec,
+                                          const f_vector<T> & dataset,
+                                          const size_t max_batch_size,
+                                          const size_t replicas)
+{
+    if (spec.kind == FInputKind::WORKLOAD) {
+        std::cout << "ERROR: the application has no synthetic workload!\n";
+        exit(-1);
+    }
+
+    const bool uses_dataset = (spec.kind != FInputKind::SOCKET or spec.local);
+    if (uses_dataset and dataset.empty()) {
+        std::cout << "ERROR: the input needs a dataset, none was loaded!\n";
+        exit(-1);
+    }
+
+    switch (spec.kind) {
+        case FInputKind::MMAP:
+            if (access(spec.path.c_str(), F_OK) != 0) {
+                if (!f_save_records(spec.path, dataset.data(), dataset.size())) {
+                    std::cout << "ERROR: cannot write " << spec.path << "!\n";
+                    exit(-1);
+                }
+                std::cout << dataset.size() << " records written to " << spec.path << std::endl;
+            }
+            return std::unique_ptr< FInput<T> >(new FMmapInput<T>(spec.path, replicas));
+        case FInputKind::UNIFORM:
+        case FInputKind::ZIPF:
+            return std::unique_ptr< FInput<T> >(new FGeneratorInput<T>(dataset.data(), dataset.size(),
+                                                                     FKeyDistribution(spec.keys, spec.s),
+                                                                     replicas));
+        case FInputKind::SOCKET:
+            return std::unique_ptr< FInput<T> >(new FSocketInput<T>(spec.path, replicas,
+                                                                  spec.local ? dataset.data() : nullptr,
+                                                                  dataset.size()));
+        default:
+            return std::unique_ptr< FInput<T> >(new FReplayInput<T>(dataset.data(), dataset.size(),
+                                                                  max_batch_size, replicas));
+    }
+}
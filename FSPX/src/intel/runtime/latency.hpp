@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+
+#include "utils.hpp"
+
+// End-to-end latency timestamps.
+// The host clock is the 64-bit CLOCK_MONOTONIC of current_time_ns(). A tuple
+// only carries the low 32 bits of the nanoseconds elapsed since the start of
+// the run, and the latency is the difference of two stamps modulo 2^32: it
+// stays correct however long the run is, as long as a single tuple spends
+// less than ~4.29 s between the source and the sink.
+typedef uint32_t FLatencyStamp;
+
+ALWAYS_INLINE FLatencyStamp f_latency_stamp(const uint64_t epoch_ns,
+                                            const uint64_t now_ns = current_time_ns())
+{
+    return static_cast<FLatencyStamp>(now_ns - epoch_ns);
+}
+
+ALWAYS_INLINE uint32_t f_latency_ns(const FLatencyStamp source_stamp,
+                                    const FLatencyStamp sink_stamp)
+{
+    return static_cast<uint32_t>(sink_stamp - source_stamp);
+}
+
+
+// Cost and resolution of the host clock, measured once per run. Every
+// latency sample includes one clock read, so latencies of the same order as
+// `read_ns` are noise.
+struct FClockCalibration
+{
+    double resolution_ns;   // clock_getres
+    double read_ns;         // smallest difference between two consecutive reads
+
+    static FClockCalibration measure(const size_t reads = 1000)
+    {
+        FClockCalibration c;
+        struct timespec res;
+        clock_getres(CLOCK_MONOTONIC, &res);
+        c.resolution_ns = res.tv_sec * 1e9 + res.tv_nsec;
+
+        uint64_t best = UINT64_MAX;
+        for (size_t i = 0; i < reads; ++i) {
+            const uint64_t t0 = current_time_ns();
+            const uint64_t t1 = current_time_ns();
+            best = std::min(best, t1 - t0);
+        }
+        c.read_ns = best;
+        return c;
+    }
+};
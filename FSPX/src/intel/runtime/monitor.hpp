@@ -0,0 +1,310 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "utils.hpp"
+
+// Counters published by the source and sink threads while the pipe runs
+struct FMonitorSample
+{
+    uint64_t time_ns;
+    uint64_t sent_tuples;
+    uint64_t sent_batches;
+    uint64_t received_tuples;
+    uint64_t received_batches;
+    uint64_t source_wait_ns;    // time the sources spent blocked in get_batch (backpressure)
+    uint64_t sink_wait_ns;      // time the sinks spent blocked in pop
+};
+
+
+// Most recent latency samples, one per sink batch. Percentiles over the
+// window follow the run instead of being averaged over all of it.
+struct FLatencyWindow
+{
+    std::mutex mutex;
+    std::vector<uint32_t> ring;
+    size_t next;
+    size_t count;
+
+    FLatencyWindow(const size_t size = 4096)
+    : ring(size)
+    , next(0)
+    , count(0)
+    {}
+
+    void add(const uint32_t latency)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ring[next] = latency;
+        next = (next + 1 == ring.size()) ? 0 : next + 1;
+        count = std::min(count + 1, ring.size());
+    }
+
+    std::vector<uint32_t> snapshot()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::vector<uint32_t>(ring.begin(), ring.begin() + count);
+    }
+};
+
+
+// Reporter thread: every `interval_ms` it takes a sample, appends it to
+// `filepath` (one tab-separated line per sample) and publishes it as text
+// exposition on `endpoint`:
+//   none          no endpoint
+//   http:PORT     HTTP on 127.0.0.1:PORT, e.g., `curl localhost:PORT`
+//   unix:PATH     plain text on a Unix socket, e.g., `socat - UNIX-CONNECT:PATH`
+struct FMonitor
+{
+    typedef std::function<FMonitorSample()> SampleFun;
+
+    size_t interval_ms;
+    std::string endpoint;
+    std::string filepath;
+    std::string label;
+    SampleFun sample_fun;
+    FLatencyWindow * latency;
+    size_t source_tuple_bytes;
+    size_t sink_tuple_bytes;
+
+    std::atomic<bool> stop_flag;
+    std::thread thread;
+    int listen_fd;
+    bool is_http;
+
+    FMonitor(const size_t interval_ms,
+             const std::string & endpoint,
+             const std::string & filepath,
+             const std::string & label,
+             SampleFun sample_fun,
+             FLatencyWindow * latency,
+             const size_t source_tuple_bytes,
+             const size_t sink_tuple_bytes)
+    : interval_ms(interval_ms)
+    , endpoint(endpoint)
+    , filepath(filepath)
+    , label(label)
+    , sample_fun(sample_fun)
+    , latency(latency)
+    , source_tuple_bytes(source_tuple_bytes)
+    , sink_tuple_bytes(sink_tuple_bytes)
+    , stop_flag(false)
+    , listen_fd(-1)
+    , is_http(false)
+    {}
+
+    FMonitor(const FMonitor &) = delete;
+    FMonitor & operator=(const FMonitor &) = delete;
+
+    ~FMonitor() { stop(); }
+
+    // returns false if `endpoint` is malformed
+    static bool valid_endpoint(const std::string & endpoint)
+    {
+        if (endpoint.empty() or endpoint.compare("none") == 0) return true;
+        if (endpoint.compare(0, 5, "http:") == 0) return atoi(endpoint.c_str() + 5) > 0;
+        if (endpoint.compare(0, 5, "unix:") == 0) return endpoint.size() > 5;
+        return false;
+    }
+
+    void start()
+    {
+        if (interval_ms == 0) return;
+        open_endpoint();
+        thread = std::thread(&FMonitor::run, this);
+    }
+
+    void stop()
+    {
+        if (!thread.joinable()) return;
+        stop_flag = true;
+        thread.join();
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            listen_fd = -1;
+            if (!is_http) unlink(endpoint.c_str() + 5);
+        }
+    }
+
+private:
+
+    void open_endpoint()
+    {
+        if (endpoint.compare(0, 5, "http:") == 0) {
+            is_http = true;
+            listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+            const int one = 1;
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(atoi(endpoint.c_str() + 5));
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (listen_fd < 0 or bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+                close_endpoint("FMonitor: cannot bind " + endpoint);
+                return;
+            }
+        } else if (endpoint.compare(0, 5, "unix:") == 0) {
+            const std::string path = endpoint.substr(5);
+            listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+            unlink(path.c_str());
+            if (listen_fd < 0 or bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+                close_endpoint("FMonitor: cannot bind " + endpoint);
+                return;
+            }
+        } else {
+            return;
+        }
+
+        if (listen(listen_fd, 8) != 0) {
+            close_endpoint("FMonitor: cannot listen on " + endpoint);
+        }
+    }
+
+    void close_endpoint(const std::string & msg)
+    {
+        std::cout << msg << ", the endpoint is disabled" << std::endl;
+        if (listen_fd >= 0) close(listen_fd);
+        listen_fd = -1;
+    }
+
+    static double percentile(std::vector<uint32_t> & v, const double p)
+    {
+        if (v.empty()) return 0;
+        auto it = v.begin() + static_cast<size_t>((v.size() - 1) * p);
+        std::nth_element(v.begin(), it, v.end());
+        return *it;
+    }
+
+    void run()
+    {
+        std::ofstream file;
+        if (!filepath.empty()) {
+            const bool write_header = !std::ifstream(filepath).good();
+            file.open(filepath, std::ios_base::app);
+            if (write_header) {
+                file << "label\tt_s\tsent_tuples\tsent_batches\treceived_tuples\treceived_batches"
+                     << "\tsource_wait_ns\tsink_wait_ns\tthroughput\tsource_bandwidth\tsink_bandwidth"
+                     << "\tlatency_p50\tlatency_p95\tlatency_p99\n";
+            }
+        }
+
+        FMonitorSample prev = sample_fun();
+        const uint64_t start_ns = prev.time_ns;
+        uint64_t next_ns = start_ns + interval_ms * uint64_t(1000000);
+        std::string text = "";
+
+        while (!stop_flag) {
+            // serves the endpoint until the next sample is due
+            const uint64_t now_ns = current_time_ns();
+            if (now_ns < next_ns) {
+                const int timeout_ms = std::min<uint64_t>((next_ns - now_ns) / 1000000 + 1, 100);
+                if (listen_fd >= 0) {
+                    struct pollfd pfd = {listen_fd, POLLIN, 0};
+                    if (poll(&pfd, 1, timeout_ms) > 0) serve(text);
+                } else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+                }
+                continue;
+            }
+            next_ns += interval_ms * uint64_t(1000000);
+
+            const FMonitorSample s = sample_fun();
+            const double dt_s = (s.time_ns - prev.time_ns) * 1e-9;
+            const double throughput = (s.sent_tuples - prev.sent_tuples) / dt_s;
+            const double source_bandwidth = throughput * source_tuple_bytes;
+            const double sink_bandwidth = (s.received_tuples - prev.received_tuples) * sink_tuple_bytes / dt_s;
+
+            std::vector<uint32_t> lat;
+            if (latency) lat = latency->snapshot();
+            const double p50 = percentile(lat, 0.50);
+            const double p95 = percentile(lat, 0.95);
+            const double p99 = percentile(lat, 0.99);
+
+            std::stringstream ss;
+            ss << std::setprecision(12)
+               << "fspx_sent_tuples_total "         << s.sent_tuples      << '\n'
+               << "fspx_sent_batches_total "        << s.sent_batches     << '\n'
+               << "fspx_sent_bytes_total "          << s.sent_tuples * source_tuple_bytes << '\n'
+               << "fspx_received_tuples_total "     << s.received_tuples  << '\n'
+               << "fspx_received_batches_total "    << s.received_batches << '\n'
+               << "fspx_received_bytes_total "      << s.received_tuples * sink_tuple_bytes << '\n'
+               << "fspx_source_wait_seconds_total " << s.source_wait_ns * 1e-9 << '\n'
+               << "fspx_sink_wait_seconds_total "   << s.sink_wait_ns * 1e-9 << '\n'
+               << "fspx_pending_tuples "            << (s.sent_tuples - std::min(s.sent_tuples, s.received_tuples)) << '\n'
+               << "fspx_throughput "                << throughput         << '\n'
+               << "fspx_source_bandwidth "          << source_bandwidth   << '\n'
+               << "fspx_sink_bandwidth "            << sink_bandwidth     << '\n';
+            if (latency) {
+                ss << "fspx_latency_ns{quantile=\"0.5\"} "  << p50 << '\n'
+                   << "fspx_latency_ns{quantile=\"0.95\"} " << p95 << '\n'
+                   << "fspx_latency_ns{quantile=\"0.99\"} " << p99 << '\n';
+            }
+            text = ss.str();
+
+            if (file.is_open()) {
+                file << std::setprecision(12)
+                     << label << '\t' << (s.time_ns - start_ns) * 1e-9 << '\t'
+                     << s.sent_tuples << '\t' << s.sent_batches << '\t'
+                     << s.received_tuples << '\t' << s.received_batches << '\t'
+                     << s.source_wait_ns << '\t' << s.sink_wait_ns << '\t'
+                     << throughput << '\t' << source_bandwidth << '\t' << sink_bandwidth << '\t'
+                     << p50 << '\t' << p95 << '\t' << p99 << '\n';
+                file.flush();
+            }
+
+            prev = s;
+        }
+    }
+
+    void serve(const std::string & text)
+    {
+        const int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) return;
+
+        std::string response = text;
+        if (is_http) {
+            // the request is not parsed, every path returns the metrics
+            char request[1024];
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) > 0) {
+                (void)!read(fd, request, sizeof(request));
+            }
+            response = "HTTP/1.0 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: " + std::to_string(text.size()) + "\r\n"
+                       "Connection: close\r\n\r\n" + text;
+        }
+        size_t sent = 0;
+        while (sent < response.size()) {
+            const ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += n;
+        }
+        close(fd);
+    }
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <time.h>
+
+#include "utils.hpp"
+
+// Offered load of the source threads, as tuples/s over time:
+//   max                            as fast as possible (no pacing)
+//   const:RATE                     constant rate
+//   step:SECONDS,R0,R1,...         each rate is held for SECONDS, the last one forever
+//   sin:MEAN,AMPLITUDE,PERIOD_S    MEAN + AMPLITUDE * sin(2 pi t / PERIOD_S)
+//   burst:BASE,PEAK,ON_S,PERIOD_S  PEAK for the first ON_S seconds of every period, BASE otherwise
+//   replay:SPEEDUP                 original inter-arrival times of the dataset, SPEEDUP times faster
+enum struct FRateKind {
+    MAX,
+    CONSTANT,
+    STEP,
+    SINUSOID,
+    BURST,
+    REPLAY
+};
+
+struct FRateProfile
+{
+    FRateKind kind;
+    std::vector<double> params;
+    std::vector<uint64_t> arrivals_ns;  // REPLAY: arrival time of each dataset tuple, from the first one
+
+    FRateProfile()
+    : kind(FRateKind::MAX)
+    {}
+
+    // returns false if `str` is malformed
+    bool parse(const std::string & str)
+    {
+        const size_t colon = str.find(':');
+        const std::string name = str.substr(0, colon);
+
+        params.clear();
+        if (colon != std::string::npos) {
+            std::stringstream ss(str.substr(colon + 1));
+            for (double v; ss >> v;) {
+                params.push_back(v);
+                if (ss.peek() == ',')
+                    ss.ignore();
+            }
+        }
+
+        size_t expected = 0;
+        if (name.compare("max") == 0)         { kind = FRateKind::MAX;      expected = 0; }
+        else if (name.compare("const") == 0)  { kind = FRateKind::CONSTANT; expected = 1; }
+        else if (name.compare("step") == 0)   { kind = FRateKind::STEP;     expected = 2; }
+        else if (name.compare("sin") == 0)    { kind = FRateKind::SINUSOID; expected = 3; }
+        else if (name.compare("burst") == 0)  { kind = FRateKind::BURST;    expected = 4; }
+        else if (name.compare("replay") == 0) { kind = FRateKind::REPLAY;   expected = 1; }
+        else return false;
+
+        if (kind == FRateKind::STEP) return (params.size() >= expected and params[0] > 0);
+        if (kind == FRateKind::SINUSOID) return (params.size() == expected and params[2] > 0);
+        if (kind == FRateKind::BURST) return (params.size() == expected and params[3] > 0);
+        if (kind == FRateKind::REPLAY) return (params.size() == expected and params[0] > 0);
+        return (params.size() == expected);
+    }
+
+    // tuples/s offered at `t_s` seconds from the start (not used by MAX and REPLAY)
+    double rate_at(const double t_s) const
+    {
+        switch (kind) {
+            case FRateKind::CONSTANT:
+                return params[0];
+            case FRateKind::STEP: {
+                const size_t step = static_cast<size_t>(t_s / params[0]);
+                return params[std::min(step + 1, params.size() - 1)];
+            }
+            case FRateKind::SINUSOID:
+                return std::max(0.0, params[0] + params[1] * std::sin(2 * M_PI * t_s / params[2]));
+            case FRateKind::BURST:
+                return (std::fmod(t_s, params[3]) < params[2]) ? params[1] : params[0];
+            default:
+                return 0;
+        }
+    }
+};
+
+
+// Token bucket at batch granularity, one per source thread. The bucket is
+// refilled at rate_at(t) / sources and holds at most `depth` tuples, so a
+// source that falls behind (e.g., backpressure) catches up by at most
+// `depth` tuples instead of bursting the whole backlog.
+struct FRatePacer
+{
+    const FRateProfile & profile;
+    size_t sources;
+    uint64_t start_ns;
+    double depth;
+    double tokens;
+    uint64_t last_ns;
+    uint64_t sent;      // REPLAY: tuples released so far
+
+    FRatePacer(const FRateProfile & profile,
+               const size_t sources,
+               const uint64_t start_ns,
+               const size_t depth)
+    : profile(profile)
+    , sources(sources)
+    , start_ns(start_ns)
+    , depth(depth)
+    , tokens(0)
+    , last_ns(start_ns)
+    , sent(0)
+    {}
+
+    // blocks until a batch of `n` tuples can be released
+    void wait(const size_t n)
+    {
+        if (profile.kind == FRateKind::MAX) return;
+
+        if (profile.kind == FRateKind::REPLAY) {
+            sleep_until(replay_due_ns());
+            sent += n;
+            return;
+        }
+
+        while (true) {
+            const uint64_t now_ns = current_time_ns();
+            const double rate = refill(now_ns, n);
+            if (tokens >= n) {
+                tokens -= n;
+                return;
+            }
+
+            // no rate (e.g., burst off with BASE = 0): check again in 1 ms
+            const double missing_ns = (rate > 0) ? (n - tokens) / rate * 1e9 : 1e6;
+            sleep_until(now_ns + static_cast<uint64_t>(std::min(missing_ns, 1e6)));
+        }
+    }
+
+    // non-blocking wait: true, and the batch is released, if `n` tuples can
+    // be sent now
+    bool try_take(const size_t n)
+    {
+        if (profile.kind == FRateKind::MAX) return true;
+
+        if (profile.kind == FRateKind::REPLAY) {
+            if (current_time_ns() < replay_due_ns()) return false;
+            sent += n;
+            return true;
+        }
+
+        refill(current_time_ns(), n);
+        if (tokens < n) return false;
+        tokens -= n;
+        return true;
+    }
+
+    // each of the `sources` threads replays the dataset timeline `sources`
+    // times slower, so the aggregate follows the original one (the host
+    // rejects a REPLAY profile without arrivals)
+    uint64_t replay_due_ns() const
+    {
+        const std::vector<uint64_t> & arrivals = profile.arrivals_ns;
+        const uint64_t span_ns = arrivals.back() + (arrivals.size() > 1 ? arrivals.back() / (arrivals.size() - 1) : 1);
+        const uint64_t loop = sent / arrivals.size();
+        const uint64_t due_ns = loop * span_ns + arrivals[sent % arrivals.size()];
+        return start_ns + static_cast<uint64_t>(due_ns * sources / profile.params[0]);
+    }
+
+    // adds the tokens accrued since the last refill, returns the current rate
+    double refill(const uint64_t now_ns,
+                  const size_t n)
+    {
+        const double capacity = std::max(depth, static_cast<double>(n));
+        const double rate = profile.rate_at((now_ns - start_ns) * 1e-9) / sources;
+        tokens = std::min(tokens + rate * (now_ns - last_ns) * 1e-9, capacity);
+        last_ns = now_ns;
+        return rate;
+    }
+
+    // sleeps for most of the interval and spins on the remaining part
+    static void sleep_until(const uint64_t deadline_ns)
+    {
+        const uint64_t spin_ns = 50000;
+        uint64_t now_ns = current_time_ns();
+        if (deadline_ns > now_ns + spin_ns) {
+            const uint64_t sleep_ns = deadline_ns - now_ns - spin_ns;
+            struct timespec ts;
+            ts.tv_sec = sleep_ns / 1000000000;
+            ts.tv_nsec = sleep_ns % 1000000000;
+            nanosleep(&ts, NULL);
+        }
+        while (current_time_ns() < deadline_ns) {
+            std::this_thread::yield();
+        }
+    }
+};
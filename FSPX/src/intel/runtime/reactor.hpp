@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <string>
+#include <iostream>
+#include <ctime>
+#include <algorithm>
+
+#include "utils.hpp"
+#include "counters.hpp"
+
+// A source or sink replica driven by FReactor
+struct FReactorTask
+{
+    virtual ~FReactorTask() {}
+
+    // advances by at most one batch without blocking, true if it did
+    virtual bool try_step() = 0;
+
+    // true once the replica sent (or received) its last batch
+    virtual bool done() const = 0;
+};
+
+
+// Reactor mode: `threads` threads round-robin over all the replicas with
+// non-blocking readiness checks, instead of one mostly-blocked thread per
+// replica. Task i is always served by thread i % threads, so a replica is
+// never stepped by two threads. After a pass without progress a thread
+// yields, after `spin_passes` of them it sleeps `idle_sleep_us` per pass.
+struct FReactor
+{
+    // written only by its thread, read after join
+    struct alignas(F_CACHE_LINE_SIZE) Stats
+    {
+        uint64_t passes;
+        uint64_t idle_passes;
+        uint64_t steps;
+
+        Stats()
+        : passes(0)
+        , idle_passes(0)
+        , steps(0)
+        {}
+    };
+
+    size_t threads_n;
+    size_t spin_passes;
+    size_t idle_sleep_us;
+    std::vector<FReactorTask *> tasks;
+    std::vector<std::thread> threads;
+    Stats * stats;
+
+    FReactor(const size_t threads_n,
+             const size_t spin_passes = 64,
+             const size_t idle_sleep_us = 5)
+    : threads_n(threads_n)
+    , spin_passes(spin_passes)
+    , idle_sleep_us(idle_sleep_us)
+    , stats(nullptr)
+    {}
+
+    FReactor(const FReactor &) = delete;
+    FReactor & operator=(const FReactor &) = delete;
+
+    ~FReactor()
+    {
+        join();
+        if (stats) f_delete_blocks(stats, threads_n);
+    }
+
+    void add(FReactorTask * task) { tasks.push_back(task); }
+
+    void start()
+    {
+        threads_n = std::max<size_t>(1, std::min(threads_n, tasks.size()));
+        stats = f_new_blocks<Stats>(threads_n);
+        const std::string start_str = "Reactor: " + std::to_string(threads_n) + " thread(s) over "
+                                    + std::to_string(tasks.size()) + " replicas\n";
+        std::cout << start_str;
+        for (size_t t = 0; t < threads_n; ++t) {
+            threads.emplace_back(&FReactor::run, this, t);
+        }
+    }
+
+    void join()
+    {
+        for (auto & t : threads) {
+            if (t.joinable()) t.join();
+        }
+        threads.clear();
+    }
+
+    uint64_t passes() const      { return sum(&Stats::passes); }
+    uint64_t idle_passes() const { return sum(&Stats::idle_passes); }
+    uint64_t steps() const       { return sum(&Stats::steps); }
+
+private:
+
+    void run(const size_t t)
+    {
+        std::vector<FReactorTask *> own;
+        for (size_t i = t; i < tasks.size(); i += threads_n) {
+            own.push_back(tasks[i]);
+        }
+
+        Stats & s = stats[t];
+        size_t idle = 0;
+        size_t running = own.size();
+        while (running > 0) {
+            bool progress = false;
+            running = 0;
+            for (auto task : own) {
+                if (task->done()) continue;
+                running++;
+                if (task->try_step()) {
+                    progress = true;
+                    s.steps++;
+                }
+            }
+            s.passes++;
+
+            if (progress) {
+                idle = 0;
+            } else if (running > 0) {
+                s.idle_passes++;
+                if (++idle < spin_passes) {
+                    std::this_thread::yield();
+                } else {
+                    struct timespec ts;
+                    ts.tv_sec = 0;
+                    ts.tv_nsec = idle_sleep_us * 1000;
+                    nanosleep(&ts, NULL);
+                }
+            }
+        }
+    }
+
+    uint64_t sum(uint64_t Stats::* field) const
+    {
+        uint64_t total = 0;
+        for (size_t t = 0; stats and t < threads_n; ++t) {
+            total += stats[t].*field;
+        }
+        return total;
+    }
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+
+// Benchmark sweep specification, one parameter per line:
+//   # comment
+//   key = value1 value2 ...
+// The sweep is the cartesian product of all the values, in the order of the
+// file (the first key varies slowest). Values are kept as strings, each
+// host converts the keys it knows.
+struct FSweep
+{
+    typedef std::vector<std::pair<std::string, std::string>> Config;
+
+    std::vector<std::pair<std::string, std::vector<std::string>>> params;
+
+    // returns false if `filepath` cannot be read or a line is malformed
+    bool load(const std::string & filepath)
+    {
+        std::ifstream in(filepath);
+        if (!in.is_open()) {
+            std::cerr << "FSweep: cannot open " << filepath << std::endl;
+            return false;
+        }
+
+        params.clear();
+        std::string line;
+        for (size_t n = 1; std::getline(in, line); ++n) {
+            const size_t hash = line.find('#');
+            if (hash != std::string::npos) line.erase(hash);
+
+            const size_t eq = line.find('=');
+            std::stringstream key_ss(line.substr(0, eq));
+            std::string key;
+            if (!(key_ss >> key)) continue;
+            if (eq == std::string::npos) {
+                std::cerr << "FSweep: " << filepath << ':' << n << ": expected `key = values`" << std::endl;
+                return false;
+            }
+
+            std::vector<std::string> values;
+            std::stringstream ss(line.substr(eq + 1));
+            for (std::string v; ss >> v;) values.push_back(v);
+            if (values.empty()) {
+                std::cerr << "FSweep: " << filepath << ':' << n << ": no values for " << key << std::endl;
+                return false;
+            }
+            params.emplace_back(key, values);
+        }
+        return true;
+    }
+
+    std::vector<Config> configs() const
+    {
+        std::vector<Config> out(1);
+        for (auto & p : params) {
+            std::vector<Config> next;
+            for (auto & c : out) {
+                for (auto & v : p.second) {
+                    next.push_back(c);
+                    next.back().emplace_back(p.first, v);
+                }
+            }
+            out.swap(next);
+        }
+        return out;
+    }
+
+    static std::string get(const Config & config,
+                           const std::string & key,
+                           const std::string & default_value)
+    {
+        for (auto & kv : config) {
+            if (kv.first == key) return kv.second;
+        }
+        return default_value;
+    }
+
+    static size_t get_size(const Config & config,
+                           const std::string & key,
+                           const size_t default_value)
+    {
+        const std::string v = get(config, key, "");
+        return v.empty() ? default_value : strtoull(v.c_str(), NULL, 10);
+    }
+
+    static double get_double(const Config & config,
+                             const std::string & key,
+                             const double default_value)
+    {
+        const std::string v = get(config, key, "");
+        return v.empty() ? default_value : atof(v.c_str());
+    }
+};
+
+
+// `results` of a configuration is the prefix of the `.jsonl` and `.csv`
+// files, a trailing extension (as in the old per-run results file) is dropped
+inline std::string f_results_prefix(const std::string & results)
+{
+    for (const char * ext : {".csv", ".tsv", ".jsonl"}) {
+        const std::string e(ext);
+        if (results.size() > e.size() and results.compare(results.size() - e.size(), e.size(), e) == 0) {
+            return results.substr(0, results.size() - e.size());
+        }
+    }
+    return results;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "utils.hpp"
+#include "counters.hpp"
+#include "input.hpp"
+
+// Synthetic streams with per-key state: the key of each tuple is drawn from
+// `keys`, its other fields are the next step of the process of that key. The
+// processes are application specific (e.g., includes/workload.hpp), a
+// Process provides:
+//
+//   struct State;                                              // of a key
+//   void init(State & s, uint32_t key, uint64_t & rng) const;
+//   void next(T & t, State & s, uint64_t & rng) const;         // all but t.key
+//
+// Every key is owned by one replica, so the tuples of a key are the steps of
+// a single process and replicas never share state. Keys go, hottest first,
+// to the replica with the least weight so far, and each replica draws its
+// keys from an alias table weighted by `keys`: as the replicas send at the
+// same rate, the stream of all of them follows `keys`, and the owner of a key
+// does not depend on its value (KB dispatch sees the skew). The only
+// exception is a key hotter than 1/replicas of the tuples (a steep Zipf over
+// few keys), that its replica cannot send more often: the distance from
+// `keys` is printed when it matters. Tuples are built in the batch, with two
+// random words per tuple (key, process) at most.
+template <typename T, typename Process>
+struct FWorkloadInput : FInput<T>
+{
+    struct alignas(F_CACHE_LINE_SIZE) Replica
+    {
+        uint64_t rng;
+        FAliasTable table;                      // over the owned keys
+        std::vector<uint32_t> owned;            // key of each slot
+        std::vector<typename Process::State> states;
+
+        Replica()
+        : rng(0)
+        {}
+    };
+
+    FKeyDistribution keys;
+    Process process;
+    size_t replicas;
+    uint64_t seed;
+    Replica * blocks;
+    double distance;    // total variation distance of the stream from `keys`
+
+    FWorkloadInput(const FKeyDistribution & keys,
+                   const Process & process,
+                   const size_t replicas,
+                   const uint64_t seed = 1)
+    : keys(keys)
+    , process(process)
+    , replicas(replicas)
+    , seed(seed)
+    , blocks(f_new_blocks<Replica>(replicas))
+    , distance(0)
+    {
+        if (keys.keys < replicas) {
+            std::cout << "ERROR: the workload needs at least one key per source replica!\n";
+            exit(-1);
+        }
+
+        // Zipf weights decrease with the key, so keys are already hottest first
+        std::vector<double> weights(keys.keys);
+        double total = 0;
+        for (uint32_t k = 0; k < keys.keys; ++k) {
+            weights[k] = (keys.s > 0) ? 1.0 / std::pow(k + 1.0, keys.s) : 1.0;
+            total += weights[k];
+        }
+        std::vector<double> load(replicas, 0);
+        std::vector<std::vector<double>> owned_weights(replicas);
+        for (uint32_t k = 0; k < keys.keys; ++k) {
+            const size_t rid = std::min_element(load.begin(), load.end()) - load.begin();
+            load[rid] += weights[k];
+            blocks[rid].owned.push_back(k);
+            owned_weights[rid].push_back(weights[k]);
+        }
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            blocks[rid].table = FAliasTable(owned_weights[rid]);
+            blocks[rid].states.resize(blocks[rid].owned.size());
+            for (size_t i = 0; i < owned_weights[rid].size(); ++i) {
+                const double share = owned_weights[rid][i] / (load[rid] * replicas);
+                distance += std::abs(share - owned_weights[rid][i] / total) / 2;
+            }
+        }
+        if (distance > 0.01) {
+            std::cout << "Workload: with " << replicas << " source replicas the keys are "
+                      << distance << " (total variation) from the distribution\n";
+        }
+        rewind();
+    }
+
+    FWorkloadInput(const FWorkloadInput &) = delete;
+    FWorkloadInput & operator=(const FWorkloadInput &) = delete;
+
+    ~FWorkloadInput() { f_delete_blocks(blocks, replicas); }
+
+    // the same streams in every run
+    void rewind()
+    {
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            Replica & r = blocks[rid];
+            r.rng = f_rand_seed(seed + rid);
+            for (size_t i = 0; i < r.states.size(); ++i) {
+                process.init(r.states[i], r.owned[i], r.rng);
+            }
+        }
+    }
+
+    size_t fill(T * batch,
+                const size_t n,
+                const size_t rid,
+                const FInputStamp * stamp)
+    {
+        Replica & r = blocks[rid];
+        uint64_t rng = r.rng;
+        typename Process::State * states = r.states.data();
+        const uint32_t * owned = r.owned.data();
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t slot = r.table.sample(f_rand_next(rng));
+            batch[i].key = owned[slot];
+            process.next(batch[i], states[slot], rng);
+        }
+        r.rng = rng;
+        f_stamp(batch, n, stamp);
+        return n;
+    }
+};
@@ -12,6 +12,52 @@
 {%- endmacro %}
 
 
+{% macro declare_stats(node) -%}
+{% if node.instrument %}
+ulong stats_in = 0;
+ulong stats_out = 0;
+ulong stats_read_stall = 0;
+ulong stats_write_stall = 0;
+{% endif %}
+{%- endmacro %}
+
+
+{% macro store_stats(node) -%}
+{% if node.instrument %}
+fspx_stats[0] = stats_in;
+fspx_stats[1] = stats_out;
+fspx_stats[2] = stats_read_stall;
+fspx_stats[3] = stats_write_stall;
+{% endif %}
+{%- endmacro %}
+
+
+// Blocking read and write, built on the non-blocking variants to count the
+// attempts that find the channel empty or full when the node is instrumented
+{% macro read_blocking(node, i, idx, t_in) -%}
+{% if node.instrument_reads() %}
+bool valid = false;
+do {
+    {{ t_in }} = {{ node.read_nb(i, idx, 'valid') }};
+    stats_read_stall += !valid;
+} while (!valid);
+{% else %}
+{{ t_in }} = {{ node.read(i, idx) }};
+{% endif %}
+{%- endmacro %}
+
+
+{% macro write_blocking(node, idx, j, t_out) -%}
+{% if node.instrument_writes() %}
+while (!{{ node.write_nb(idx, j, t_out) }}) {
+    stats_write_stall++;
+}
+{% else %}
+{{ node.write(idx, j, t_out) }};
+{% endif %}
+{%- endmacro %}
+
+
 {% macro incr_var(var, max) -%}
 if ({{var}} == {{max - 1}}) {
     {{var}} = 0;
@@ -28,12 +74,15 @@ if ({{var}} == {{max - 1}}) {
 // -----------------------------------------------------------------------------
 
 {% macro single_read_blocking(node, idx, t_in, t_out, process_tuple) -%}
-{{ t_in }} = {{ node.read(i, idx) }};
+{{ read_blocking(node, None, idx, t_in) }}
 
 if ({{ t_in }}.EOS) {
     EOS[0] = true;
     done = true;
 } else {
+    {% if node.instrument_reads() %}
+    stats_in++;
+    {% endif %}
     {{ process_tuple(node, idx, t_in, t_out) | indent(4) }}
 }
 {%- endmacro %}
@@ -43,7 +92,15 @@ if ({{ t_in }}.EOS) {
 {% macro switch_read_blocking(node, idx, switch_var, t_in, t_out, incr, process_tuple) -%}
 switch ({{ switch_var }}) {
 {% for i in range(node.i_degree): %}
+{% if node.instrument_reads() %}
+    case {{i}}:
+        if (!EOS[{{i}}]) {
+            {{ read_blocking(node, i, idx, t_in) | indent(12) }}
+        }
+        break;
+{% else %}
     case {{i}}: if (!EOS[{{i}}]) {{ t_in }} = {{ node.read(i, idx) }}; break;
+{% endif %}
 {% endfor %}
 }
 
@@ -56,6 +113,9 @@ if ({{ t_in }}.EOS) {
     }
     done = eos;
 } else {
+    {% if node.instrument_reads() %}
+    stats_in++;
+    {% endif %}
     {{ process_tuple(node, idx, t_in, t_out) | indent(4) }}
 }
 
@@ -106,9 +166,18 @@ if (valid) {
         }
         done = eos;
     } else {
+        {% if node.instrument_reads() %}
+        stats_in++;
+        {% endif %}
         {{ process_tuple(node, idx, t_in, t_out) | indent(8) }}
     }
+{% if node.instrument_reads() %}
+} else {
+    stats_read_stall++;
+}
+{% else %}
 }
+{% endif %}
 {% if incr %}
 {{ incr_var(switch_var, node.i_degree) }}
 {% endif %}
@@ -139,7 +208,7 @@ if (valid) {
 // -----------------------------------------------------------------------------
 
 {% macro single_write_rr(node, idx, t_out) -%}
-{{ node.write(idx, None, t_out) }};
+{{ write_blocking(node, idx, None, t_out) }}
 {%- endmacro %}
 
 
@@ -147,7 +216,13 @@ if (valid) {
 {% macro switch_write_rr(node, idx, switch_var, t_out, incr) -%}
 switch ({{ switch_var }}) {
     {% for i in range(node.o_degree): %}
+    {% if node.instrument_writes() %}
+    case {{i}}:
+        {{ write_blocking(node, idx, i, t_out) | indent(8) }}
+        break;
+    {% else %}
     case {{i}}: {{ node.write(idx, i, t_out) }}; break;
+    {% endif %}
     {% endfor %}
 }
 
@@ -172,6 +247,9 @@ do {
         case {{i}}: if (!success) success = {{ node.write_nb(idx, i, t_out) }}; break;
     {% endfor %}
     }
+    {% if node.instrument_writes() %}
+    stats_write_stall += !success;
+    {% endif %}
 
     {% if incr %}
     {{ incr_var(switch_var, node.o_degree) | indent(4) }}
@@ -192,7 +270,13 @@ do {
 const uint w = {{ node.o_datatype }}_getKey({{ t_out }}.data) % {{ node.o_degree }};
 switch (w) {
 {% for i in range(node.o_degree): %}
+{% if node.instrument_writes() %}
+    case {{i}}:
+        {{ write_blocking(node, idx, i, t_out) | indent(8) }}
+        break;
+{% else %}
     case {{i}}: {{ node.write(idx, i, t_out) }}; break;
+{% endif %}
 {% endfor %}
 }
 {%- endmacro %}
@@ -201,14 +285,17 @@ switch (w) {
 {% macro write_br(node, idx, t_out) -%}
 #pragma unroll
 for (uint i = 0; i < {{ node.o_degree }}; ++i) {
-    {{ node.write(idx, 'i', t_out) }};
+    {{ write_blocking(node, idx, 'i', t_out) | indent(4) }}
 }
 {%- endmacro %}
 
 
 {% macro write_br_EOS(node, idx) -%}
 const {{ node.o_channel.tupletype }} tuple_eos = create_{{ node.o_channel.tupletype }}_EOS();
-{{ write_br(node, idx, 'tuple_eos') }}
+#pragma unroll
+for (uint i = 0; i < {{ node.o_degree }}; ++i) {
+    {{ node.write(idx, 'i', 'tuple_eos') }};
+}
 {%- endmacro %}
 
 
@@ -238,4 +325,7 @@ const {{ node.o_channel.tupletype }} tuple_eos = create_{{ node.o_channel.tuplet
 {% if node.is_dispatch_BR() %}
 {{ write_br(node, idx, t_out) }}
 {% endif %}
+{% if node.instrument_writes() %}
+stats_out++;
+{% endif %}
 {%- endmacro %}
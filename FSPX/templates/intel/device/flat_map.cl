@@ -2,13 +2,16 @@
 
 {% macro node(node, idx) -%}
 
-CL_SINGLE_TASK {{ node.kernel_name(idx) }}({{ node.parameter_global_buffers() }})
+CL_SINGLE_TASK {{ node.kernel_name(idx) }}({{ node.parameter_global_buffers() }}{{ node.parameter_stats() }})
 {
     const uint idx = {{ idx }};
 {% if node.is_dispatch_RR() and node.o_degree > 1 %}
     uint w = {{ idx % node.o_degree }};
 {% endif %}
     bool done = false;
+{% if node.instrument %}
+    {{ ch.declare_stats(node) | indent(4) }}
+{% endif %}
 {% if node.i_degree > 1 %}
     uint r = {{ idx % node.i_degree }};
 {% endif %}
@@ -29,6 +32,9 @@ CL_SINGLE_TASK {{ node.kernel_name(idx) }}({{ node.parameter_global_buffers() }}
     {{ node.call_begin_function() }};
     {% endif %}
 
+{% if node.get_ivdep_buffers() | count > 0 %}
+{{ node.declare_ivdep() | indent(4, true) }}
+{% endif %}
     while (!done) {
         {{ node.declare_i_tuple('t_in') }};
         {{ ch.gather_tuple(node, idx, 'r', 't_in', 't_out', process_tuple) | indent(8) }}
@@ -38,6 +44,9 @@ CL_SINGLE_TASK {{ node.kernel_name(idx) }}({{ node.parameter_global_buffers() }}
     {{ node.call_end_function() }};
     {% endif %}
 
+    {% if node.instrument %}
+    {{ ch.store_stats(node) | indent(4) }}
+    {% endif %}
     {{ch.write_br_EOS(node, idx)|indent(4)}}
 }
 
@@ -13,10 +13,16 @@
 #include "../../device/includes/fsp.cl"
 #include "../../common/constants.h"
 #include "../../common/tuples.h"
+#include "../runtime/breakdown.hpp"
 
 template <typename T>
 struct FSink
 {
+    // device stages of the batches, if set (see FPipeGraph::set_breakdown)
+    FLatencyBreakdown * breakdown = nullptr;
+
+    virtual ~FSink() {}
+    virtual void set_breakdown(FLatencyBreakdown * b) { breakdown = b; }
     virtual void pop_empty(const size_t rid,
                            const size_t batch_size,
                            size_t * received,
@@ -30,6 +36,13 @@ struct FSink
                     const size_t batch_size,
                     size_t * received,
                     bool * last) = 0;
+
+    // true if pop(rid, batch_size, ...) would not block
+    virtual bool poll(const size_t rid,
+                      const size_t batch_size) = 0;
+
+    // gives a popped batch back; a replica can hold up to N popped batches
+    // and gives them back in pop order (see FResultConsumers)
     virtual void put_batch(const size_t rid,
                            T * batch) = 0;
     virtual void launch_kernels() = 0;
@@ -73,22 +86,23 @@ struct FSinkCopy : FSink<T>
     size_t max_batch_size;
     size_t number_of_buffers;
     size_t previous_node_par;
+    bool out_of_order;      // see OCL::out_of_order
 
     std::vector<size_t> iterations;
 
     std::vector< std::vector<cl_kernel> > kernels;
     std::vector<cl_command_queue> kernels_queues;
+    std::vector< std::vector<cl_event> > kernels_events;    // kept only with a breakdown
+    std::vector<cl_event> last_kernel_events;               // kept only if out of order
 
     std::vector< std::vector<cl_mem> > buffers;
-    std::vector<cl_command_queue> buffers_queues;
+    std::vector<cl_command_queue> buffers_queues;           // the kernels queues if out of order
     std::vector< std::vector<cl_event> > buffers_events;
 
     std::vector< std::vector<cl_mem> > received;
-    std::vector<cl_command_queue> received_queues;
-    std::vector< std::vector<cl_event> > received_events;
+    std::vector< std::vector<cl_event> > received_events;      // read on buffers_queues
 
     std::vector<cl_mem> contexts;
-    std::vector<cl_command_queue> contexts_queues;
 
     std::vector< std::queue<T *> > batches_waiting_queue;
     std::vector< std::queue<unsigned int *> > received_waiting_queue;
@@ -99,6 +113,7 @@ struct FSinkCopy : FSink<T>
 
     std::vector<size_t> number_of_launches;
     std::vector<size_t> number_of_pop;
+    std::vector<T *> batches_memory;
 
     FSinkCopy(OCL & ocl,
              const size_t par,
@@ -110,23 +125,25 @@ struct FSinkCopy : FSink<T>
     , max_batch_size(next_pow2(batch_size))
     , number_of_buffers(N)
     , previous_node_par(previous_node_par)
+    , out_of_order(ocl.out_of_order)
     , iterations(par, 0)
     , kernels(par, std::vector<cl_kernel>(number_of_buffers))
     , kernels_queues(par)
+    , kernels_events(par, std::vector<cl_event>(number_of_buffers, NULL))
+    , last_kernel_events(par, NULL)
     , buffers(par, std::vector<cl_mem>(number_of_buffers))
     , buffers_queues(par)
     , buffers_events(par, std::vector<cl_event>(number_of_buffers))
     , received(par, std::vector<cl_mem>(number_of_buffers))
-    , received_queues(par)
     , received_events(par, std::vector<cl_event>(number_of_buffers))
     , contexts(par)
-    , contexts_queues(par)
     , batches_waiting_queue(par, std::queue<T *>())
     , received_waiting_queue(par, std::queue<unsigned int *>())
     , batches_read_queue(par, std::queue<T *>())
     , received_read_queue(par, std::queue<unsigned int *>())
     , number_of_launches(par, 0)
     , number_of_pop(par, 0)
+    , batches_memory(par, nullptr)
     {
         if (batch_size != max_batch_size) {
             std::cout << "FSinkCopy: `batch_size` is rounded to the next power of 2 ("
@@ -141,10 +158,22 @@ struct FSinkCopy : FSink<T>
 
         cl_int status;
         for (size_t rid = 0; rid < par; ++rid) {
-            kernels_queues[rid] = ocl.createCommandQueue();
-            buffers_queues[rid] = ocl.createCommandQueue();
-            received_queues[rid] = ocl.createCommandQueue();
-            contexts_queues[rid] = ocl.createCommandQueue();
+            if (out_of_order) {
+                kernels_queues[rid] = ocl.getQueue(FQueueRole::KERNEL, "sink_" + std::to_string(rid), true);
+                buffers_queues[rid] = kernels_queues[rid];
+            } else {
+                kernels_queues[rid] = ocl.getQueue(FQueueRole::KERNEL, "sink_" + std::to_string(rid));
+                buffers_queues[rid] = ocl.getQueue(FQueueRole::READ, rid);
+            }
+
+            // one contiguous region per replica so that it can be backed by huge pages
+            batches_memory[rid] = f_alloc<T>(number_of_buffers * max_batch_size);
+
+            contexts[rid] = clCreateBuffer(ocl.context,
+                                           CL_MEM_COPY_HOST_PTR | CL_MEM_READ_WRITE,
+                                           sizeof(mw_context_t),
+                                           &empty_context, &status);
+            clCheckErrorMsg(status, "Failed to create clBuffer (context_mem)");
 
             for (size_t n = 0; n < number_of_buffers; ++n) {
                 kernels[rid][n] = ocl.createKernel("sink_" + std::to_string(rid));
@@ -161,13 +190,7 @@ struct FSinkCopy : FSink<T>
                                                   NULL, &status);
                 clCheckErrorMsg(status, "Failed to create clBuffer (received_mem)");
 
-                contexts[rid] = clCreateBuffer(ocl.context,
-                                               CL_MEM_COPY_HOST_PTR | CL_MEM_READ_WRITE,
-                                               sizeof(mw_context_t),
-                                               &empty_context, &status);
-                clCheckErrorMsg(status, "Failed to create clBuffer (context_mem)");
-
-                batches_waiting_queue[rid].push(f_alloc<T>(max_batch_size));
+                batches_waiting_queue[rid].push(batches_memory[rid] + n * max_batch_size);
                 received_waiting_queue[rid].push(f_alloc<unsigned int>(1));
             }
         }
@@ -194,17 +217,25 @@ struct FSinkCopy : FSink<T>
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(_batch_size),   &_batch_size));
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(contexts[rid]), &contexts[rid]));
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(received[rid][idx]), &received[rid][idx]));
-        clCheckError(clEnqueueTask(kernels_queues[rid], kernels[rid][idx], 0, NULL, &kernel_event));
+
+        // out of order, the kernel also waits for the previous one of the replica
+        const cl_uint num_events = (out_of_order and last_kernel_events[rid]) ? 1 : 0;
+        clCheckError(clEnqueueTask(kernels_queues[rid], kernels[rid][idx],
+                                   num_events, (num_events > 0 ? &last_kernel_events[rid] : NULL), &kernel_event));
+        if (out_of_order) {
+            if (last_kernel_events[rid]) clCheckError(clReleaseEvent(last_kernel_events[rid]));
+            clCheckError(clRetainEvent(kernel_event));
+            last_kernel_events[rid] = kernel_event;
+        }
         if (is_flush) clFlush(kernels_queues[rid]);
 
         unsigned int * received_ = received_waiting_queue[rid].front();
         received_waiting_queue[rid].pop();
-        clCheckError(clEnqueueReadBuffer(received_queues[rid],
+        clCheckError(clEnqueueReadBuffer(buffers_queues[rid],
                                          received[rid][idx],
                                          CL_FALSE, 0,
                                          sizeof(unsigned int), received_,
                                          1, &kernel_event, &received_events[rid][idx]));
-        if (is_flush) clFlush(received_queues[rid]);
         received_read_queue[rid].push(received_);
 
         T * batch = batches_waiting_queue[rid].front();
@@ -215,7 +246,11 @@ struct FSinkCopy : FSink<T>
                                          sizeof(T) * max_batch_size, batch,
                                          1, &kernel_event, &buffers_events[rid][idx]));
         if (is_flush) clFlush(buffers_queues[rid]);
-        clCheckError(clReleaseEvent(kernel_event));
+        if (this->breakdown) {
+            kernels_events[rid][idx] = kernel_event;    // released by pop
+        } else {
+            clCheckError(clReleaseEvent(kernel_event));
+        }
         batches_read_queue[rid].push(batch);
 
         iterations[rid]++;
@@ -240,6 +275,11 @@ struct FSinkCopy : FSink<T>
         received_waiting_queue[rid].push(received_);
 
         clCheckError(clWaitForEvents(1, &buffers_events[rid][idx]));
+        if (kernels_events[rid][idx]) {
+            record_stages(rid, kernels_events[rid][idx], buffers_events[rid][idx]);
+            clCheckError(clReleaseEvent(kernels_events[rid][idx]));
+            kernels_events[rid][idx] = NULL;
+        }
         clCheckError(clReleaseEvent(buffers_events[rid][idx]));
         buffers_events[rid][idx] = NULL;
 
@@ -250,6 +290,30 @@ struct FSinkCopy : FSink<T>
         return batch;
     }
 
+    bool poll(const size_t rid,
+              const size_t batch_size)  // unused
+    {
+        (void)batch_size;
+        const size_t idx = number_of_pop[rid] % number_of_buffers;
+        return clEventDone(received_events[rid][idx]) and clEventDone(buffers_events[rid][idx]);
+    }
+
+    // both events are completed, all the counters are on the device clock
+    void record_stages(const size_t rid,
+                       cl_event kernel_event,
+                       cl_event read_event)
+    {
+        const cl_ulong k_start = clEventProfilingTime(kernel_event, CL_PROFILING_COMMAND_START);
+        const cl_ulong k_end   = clEventProfilingTime(kernel_event, CL_PROFILING_COMMAND_END);
+        const cl_ulong r_start = clEventProfilingTime(read_event, CL_PROFILING_COMMAND_START);
+        const cl_ulong r_end   = clEventProfilingTime(read_event, CL_PROFILING_COMMAND_END);
+
+        FHistogram * h = this->breakdown->sink(rid).stages;
+        h[F_STAGE_SINK_KERNEL].add(f_stage_ns(k_start, k_end));
+        h[F_STAGE_READ_QUEUE].add(f_stage_ns(k_end, r_start));
+        h[F_STAGE_READ].add(f_stage_ns(r_start, r_end));
+    }
+
     void put_batch(const size_t rid,
                    T * batch)
     {
@@ -263,7 +327,6 @@ struct FSinkCopy : FSink<T>
     {
         for (size_t rid = 0; rid < par; ++rid) {
             clFinish(buffers_queues[rid]);
-            clFinish(contexts_queues[rid]);
             clFinish(kernels_queues[rid]);
         }
     }
@@ -277,36 +340,33 @@ struct FSinkCopy : FSink<T>
             while (!received_read_queue[rid].empty()) {
                 unsigned int * b = received_read_queue[rid].front();
                 received_read_queue[rid].pop();
-                free(b);
+                f_free(b);
             }
 
             while (!batches_read_queue[rid].empty()) {
-                T * b = batches_read_queue[rid].front();
                 batches_read_queue[rid].pop();
-                free(b);
             }
 
             while (!received_waiting_queue[rid].empty()) {
                 unsigned int * b = received_waiting_queue[rid].front();
                 received_waiting_queue[rid].pop();
-                free(b);
+                f_free(b);
             }
 
             while (!batches_waiting_queue[rid].empty()) {
-                T * b = batches_waiting_queue[rid].front();
                 batches_waiting_queue[rid].pop();
-                free(b);
             }
+            f_free(batches_memory[rid]);
 
             if (contexts[rid]) clCheckError(clReleaseMemObject(contexts[rid]));
 
+            if (last_kernel_events[rid]) clCheckError(clReleaseEvent(last_kernel_events[rid]));
             for (size_t n = 0; n < number_of_buffers; ++n) {
+                if (kernels_events[rid][n]) clCheckError(clReleaseEvent(kernels_events[rid][n]));
                 if (buffers[rid][n]) clCheckError(clReleaseMemObject(buffers[rid][n]));
+                if (received[rid][n]) clCheckError(clReleaseMemObject(received[rid][n]));
                 if (kernels[rid][n]) clReleaseKernel(kernels[rid][n]);
             }
-            if (contexts_queues[rid]) clReleaseCommandQueue(contexts_queues[rid]);
-            if (buffers_queues[rid]) clReleaseCommandQueue(buffers_queues[rid]);
-            if (kernels_queues[rid]) clReleaseCommandQueue(kernels_queues[rid]);
         }
     }
 };
@@ -509,7 +569,7 @@ struct FSinkCopy : FSink<T>
             while (!batches_waiting_queue[rid].empty()) {
                 T * b = batches_waiting_queue[rid].front();
                 batches_waiting_queue[rid].pop();
-                free(b);
+                f_free(b);
             }
 
             if (contexts_queues[rid]) clReleaseCommandQueue(contexts_queues[rid]);
@@ -535,6 +595,7 @@ struct FSinkHybrid : FSink<T>
     size_t max_batch_size;
     size_t number_of_buffers;
     size_t previous_node_par;
+    bool out_of_order;      // see OCL::out_of_order
 
     std::vector<size_t> iterations;
 
@@ -544,6 +605,8 @@ struct FSinkHybrid : FSink<T>
     std::vector< std::vector< clSharedBuffer<T> > > buffers;
     std::vector< clSharedBuffer<mw_context_t> > contexts;
 
+    std::vector<cl_event> pending_events;   // kernel launched by poll, not popped yet
+
 
     FSinkHybrid(OCL & ocl,
                 const size_t par,
@@ -555,9 +618,11 @@ struct FSinkHybrid : FSink<T>
     , max_batch_size(next_pow2(batch_size))
     , number_of_buffers(N)
     , previous_node_par(previous_node_par)
+    , out_of_order(ocl.out_of_order)
     , iterations(par, 0)
     , kernels(par)
     , kernels_queues(par)
+    , pending_events(par, NULL)
     {
         if (batch_size != max_batch_size) {
             std::cout << "FSinkHybrid: `batch_size` is rounded to the next power of 2 ("
@@ -566,7 +631,9 @@ struct FSinkHybrid : FSink<T>
 
         for (size_t rid = 0; rid < par; ++rid) {
             kernels[rid] = ocl.createKernel("{{sink_name}}_" + std::to_string(rid));
-            kernels_queues[rid] = ocl.createCommandQueue();
+            // pop waits for each kernel before the next one is launched, so
+            // out of order the kernels need no wait list
+            kernels_queues[rid] = ocl.getQueue(FQueueRole::KERNEL, "{{sink_name}}_" + std::to_string(rid), out_of_order);
 
             // buffers
             std::vector< clSharedBuffer<T> > _buffs;
@@ -591,10 +658,8 @@ struct FSinkHybrid : FSink<T>
         WMB(); // ensures that writes on buffers are completed
     }
 
-    T * pop(const size_t rid,
-            const size_t batch_size,
-            size_t * received,
-            bool * last)
+    void _launch_kernel(const size_t rid,
+                        const size_t batch_size)
     {
         const cl_uint _batch_size = static_cast<cl_uint>(batch_size);
         const size_t idx = iterations[rid] % number_of_buffers;
@@ -604,11 +669,37 @@ struct FSinkHybrid : FSink<T>
         clCheckError(clSetKernelArg(kernels[rid], argi++, sizeof(_batch_size),              &_batch_size));
         clCheckError(clSetKernelArg(kernels[rid], argi++, sizeof(*contexts[rid].mem()),     contexts[rid].mem()));
 
-        cl_event kernel_event;
-        clCheckError(clEnqueueTask(kernels_queues[rid], kernels[rid], 0, NULL, &kernel_event));
+        clCheckError(clEnqueueTask(kernels_queues[rid], kernels[rid], 0, NULL, &pending_events[rid]));
         clFlush(kernels_queues[rid]);
+    }
+
+    // the kernel is launched by the first poll (or by pop), so that the
+    // next batch is collected while the caller serves other replicas
+    bool poll(const size_t rid,
+              const size_t batch_size)
+    {
+        if (!pending_events[rid]) _launch_kernel(rid, batch_size);
+        return clEventDone(pending_events[rid]);
+    }
+
+    T * pop(const size_t rid,
+            const size_t batch_size,
+            size_t * received,
+            bool * last)
+    {
+        const size_t idx = iterations[rid] % number_of_buffers;
+
+        if (!pending_events[rid]) _launch_kernel(rid, batch_size);
+        cl_event kernel_event = pending_events[rid];
+        pending_events[rid] = NULL;
 
         clCheckError(clWaitForEvents(1, &kernel_event));
+        if (this->breakdown) {
+            // no read: the kernel writes the batch to host memory
+            const cl_ulong k_start = clEventProfilingTime(kernel_event, CL_PROFILING_COMMAND_START);
+            const cl_ulong k_end   = clEventProfilingTime(kernel_event, CL_PROFILING_COMMAND_END);
+            this->breakdown->sink(rid).stages[F_STAGE_SINK_KERNEL].add(f_stage_ns(k_start, k_end));
+        }
         clCheckError(clReleaseEvent(kernel_event));
 
         mw_context_t * context = contexts[rid].ptr();
@@ -647,12 +738,12 @@ struct FSinkHybrid : FSink<T>
         finish();
 
         for (size_t rid = 0; rid < par; ++rid) {
+            if (pending_events[rid]) clCheckError(clReleaseEvent(pending_events[rid]));
             contexts[rid].release();
             for (auto & b : buffers[rid]) {
                 b.release();
             }
 
-            if (kernels_queues[rid]) clReleaseCommandQueue(kernels_queues[rid]);
             if (kernels[rid]) clReleaseKernel(kernels[rid]);
         }
     }
@@ -671,7 +762,8 @@ struct FSinkShared : FSink<T>
     std::vector<cl_kernel> kernels;
     std::vector<cl_command_queue> kernels_queues;
 
-    std::vector<size_t> header_indexes;
+    std::vector<size_t> header_indexes;    // oldest batch not given back (put_batch)
+    std::vector<size_t> pop_indexes;       // next batch to pop
     std::vector< clSharedBuffer<header_t> > headers;
     std::vector< clSharedBuffer<T> > buffers;
 
@@ -686,6 +778,7 @@ struct FSinkShared : FSink<T>
     , kernels(par)
     , kernels_queues(par)
     , header_indexes(par, 0)
+    , pop_indexes(par, 0)
     {
         if (batch_size != max_batch_size) {
             std::cout << "FSinkShared: `batch_size` is rounded to the next power of 2 ("
@@ -699,7 +792,7 @@ struct FSinkShared : FSink<T>
 
         for (size_t rid = 0; rid < par; ++rid) {
             kernels[rid] = ocl.createKernel("{{sink_name}}_" + std::to_string(rid));
-            kernels_queues[rid] = ocl.createCommandQueue();
+            kernels_queues[rid] = ocl.getQueue(FQueueRole::KERNEL, "{{sink_name}}_" + std::to_string(rid));
 
             // headers
             headers.push_back(clSharedBuffer<header_t>(ocl,
@@ -729,7 +822,7 @@ struct FSinkShared : FSink<T>
             bool * last)
     {
         (void)batch_size;
-        const size_t idx = header_indexes[rid];
+        const size_t idx = pop_indexes[rid];
 
         volatile header_t * h_ptr = &headers[rid].ptr_volatile()[idx];
 
@@ -741,9 +834,19 @@ struct FSinkShared : FSink<T>
         *received = header_size(*h_ptr);
         *last = header_close(*h_ptr);
 
+        pop_indexes[rid] = (idx + 1) % number_of_buffers;
         return batch;
     }
 
+    bool poll(const size_t rid,
+              const size_t batch_size)  // unused
+    {
+        (void)batch_size;
+        return header_ready(headers[rid].ptr_volatile()[pop_indexes[rid]]);
+    }
+
+    // gives back the oldest popped batch: up to N batches can be popped
+    // before they are given back, in pop order
     void put_batch(const size_t rid,
                    T * batch)           // unused
     {
@@ -788,7 +891,6 @@ struct FSinkShared : FSink<T>
         }
 
         for (size_t rid = 0; rid < par; ++rid) {
-            if (kernels_queues[rid]) clReleaseCommandQueue(kernels_queues[rid]);
             if (kernels[rid]) clReleaseKernel(kernels[rid]);
         }
     }
@@ -5,6 +5,7 @@
 #include <queue>
 #include <string>
 #include <chrono>
+#include <functional>
 
 // TODO: rename 'source' with "MemoryReader"
 
@@ -14,6 +15,8 @@
 #include "../../device/includes/fsp.cl"
 #include "../../common/constants.h"
 #include "../../common/tuples.h"
+#include "../runtime/breakdown.hpp"
+#include "../runtime/counters.hpp"
 
 // https://developer.arm.com/documentation/dui0802/a/A32-and-T32-Instructions/DMB--DSB--and-ISB
 #if defined(__arm__) || defined(__aarch64__)
@@ -26,10 +29,78 @@
 #endif
 
 
+// Called once the next batch of replica `rid` can be taken without
+// blocking. It may run on an OpenCL runtime thread: it must be short, e.g.,
+// set a flag or notify a condition variable.
+typedef std::function<void(size_t)> FReadyCallback;
+
 template <typename T>
 struct FSource
 {
+    size_t replicas;
+
+    // device stages of the batches, if set (see FPipeGraph::set_breakdown)
+    FLatencyBreakdown * breakdown = nullptr;
+
+    // time blocked in get_batch and failed try_get_batch, per replica
+    FBackpressureCounters * backpressure;
+
+    FSource(const size_t replicas)
+    : replicas(replicas)
+    , backpressure(f_new_blocks<FBackpressureCounters>(replicas))
+    {}
+
+    FSource(const FSource &) = delete;
+    FSource & operator=(const FSource &) = delete;
+
+    virtual ~FSource() { f_delete_blocks(backpressure, replicas); }
+    virtual void set_breakdown(FLatencyBreakdown * b) { breakdown = b; }
+
+    // blocks until one of the N buffers of replica `rid` is free
     virtual T * get_batch(const size_t rid) = 0;
+
+    // true if get_batch(rid) would not block
+    virtual bool poll(const size_t rid) = 0;
+
+    // nullptr, without blocking, if all the N buffers are in flight
+    T * try_get_batch(const size_t rid)
+    {
+        if (!poll(rid)) {
+            backpressure[rid].add_full_poll();
+            return nullptr;
+        }
+        return get_batch(rid);
+    }
+
+    // Calls `ready(rid)` once poll(rid) is true, right away if it already
+    // is. One request per replica can be pending. Returns false if the node
+    // cannot notify (poll instead).
+    virtual bool notify_ready(const size_t rid,
+                              FReadyCallback ready)
+    {
+        if (!poll(rid)) return false;
+        ready(rid);
+        return true;
+    }
+
+    uint64_t blocked_ns() const
+    {
+        uint64_t total = 0;
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            total += backpressure[rid].blocked_ns.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    uint64_t full_polls() const
+    {
+        uint64_t total = 0;
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            total += backpressure[rid].full_polls.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
     virtual void push(T * batch,
                       const size_t batch_size,
                       const size_t rid,
@@ -39,6 +110,31 @@ struct FSource
     virtual void clean() = 0;
 };
 
+// waits for `event`, counting the time as backpressure only if it was pending
+inline void f_event_wait(cl_event event,
+                         FBackpressureCounters & backpressure)
+{
+    if (clEventDone(event)) return;
+    const uint64_t start = current_time_ns();
+    clCheckError(clWaitForEvents(1, &event));
+    backpressure.add_blocked(current_time_ns() - start);
+}
+
+// one pending notify_ready per replica, called back by the OpenCL runtime
+struct FReadyRequest
+{
+    size_t rid;
+    FReadyCallback ready;
+
+    static void CL_CALLBACK on_complete(cl_event event, cl_int status, void * user_data)
+    {
+        (void)event;
+        (void)status;
+        FReadyRequest * r = static_cast<FReadyRequest *>(user_data);
+        r->ready(r->rid);
+    }
+};
+
 template <typename T>
 struct FSourceCopy : FSource<T>
 {
@@ -47,6 +143,7 @@ struct FSourceCopy : FSource<T>
 
     size_t max_batch_size;
     size_t number_of_buffers;
+    bool out_of_order;      // see OCL::out_of_order
 
     std::vector<size_t> iterations;
 
@@ -55,25 +152,34 @@ struct FSourceCopy : FSource<T>
     std::vector< std::vector<cl_event> > kernels_events;
 
     std::vector< std::vector<cl_mem> > buffers;
-    std::vector<cl_command_queue> buffers_queues;
+    std::vector<cl_command_queue> buffers_queues;           // the kernels queues if out of order
+    std::vector< std::vector<cl_event> > buffers_events;    // kept only with a breakdown
 
     std::vector< std::queue<T *> > batches_waiting_queue;
+    std::vector<T *> batches_memory;
+
+    std::vector<FReadyRequest> ready_requests;
 
     FSourceCopy(OCL & ocl,
                const size_t par,
                const size_t batch_size,
                const size_t N)
-    : ocl(ocl)
+    : FSource<T>(par)
+    , ocl(ocl)
     , par(par)
     , max_batch_size(next_pow2(batch_size))
     , number_of_buffers(N)
+    , out_of_order(ocl.out_of_order)
     , iterations(par, 0)
     , kernels(par, std::vector<cl_kernel>(number_of_buffers))
     , kernels_queues(par)
     , kernels_events(par, std::vector<cl_event>(number_of_buffers))
     , buffers(par, std::vector<cl_mem>(number_of_buffers))
     , buffers_queues(par)
+    , buffers_events(par, std::vector<cl_event>(number_of_buffers, NULL))
     , batches_waiting_queue(par, std::queue<T *>())
+    , batches_memory(par, nullptr)
+    , ready_requests(par)
     {
         if (batch_size != max_batch_size) {
             std::cout << "FSourceCopy: `batch_size` is rounded to the next power of 2 ("
@@ -81,8 +187,16 @@ struct FSourceCopy : FSource<T>
         }
 
         for (size_t rid = 0; rid < par; ++rid) {
-            kernels_queues[rid] = ocl.createCommandQueue();
-            buffers_queues[rid] = ocl.createCommandQueue();
+            if (out_of_order) {
+                kernels_queues[rid] = ocl.getQueue(FQueueRole::KERNEL, "{{source_name}}_" + std::to_string(rid), true);
+                buffers_queues[rid] = kernels_queues[rid];
+            } else {
+                kernels_queues[rid] = ocl.getQueue(FQueueRole::KERNEL, "{{source_name}}_" + std::to_string(rid));
+                buffers_queues[rid] = ocl.getQueue(FQueueRole::WRITE, rid);
+            }
+
+            // one contiguous region per replica so that it can be backed by huge pages
+            batches_memory[rid] = f_alloc<T>(number_of_buffers * max_batch_size);
 
             for (size_t n = 0; n < number_of_buffers; ++n) {
                 kernels[rid][n] = ocl.createKernel("{{source_name}}_" + std::to_string(rid));
@@ -94,7 +208,7 @@ struct FSourceCopy : FSource<T>
                                                  NULL, &status);
                 clCheckErrorMsg(status, "Failed to create clBuffer");
 
-                batches_waiting_queue[rid].push(f_alloc<T>(max_batch_size));
+                batches_waiting_queue[rid].push(batches_memory[rid] + n * max_batch_size);
             }
         }
     }
@@ -103,7 +217,12 @@ struct FSourceCopy : FSource<T>
     {
         const size_t idx = iterations[rid] % number_of_buffers;
         if (iterations[rid] >= number_of_buffers) {
-            clCheckError(clWaitForEvents(1, &kernels_events[rid][idx]));
+            f_event_wait(kernels_events[rid][idx], this->backpressure[rid]);
+            if (buffers_events[rid][idx]) {
+                record_stages(rid, buffers_events[rid][idx], kernels_events[rid][idx]);
+                clCheckError(clReleaseEvent(buffers_events[rid][idx]));
+                buffers_events[rid][idx] = NULL;
+            }
             clCheckError(clReleaseEvent(kernels_events[rid][idx]));
             kernels_events[rid][idx] = NULL;
         }
@@ -113,6 +232,27 @@ struct FSourceCopy : FSource<T>
         return b;
     }
 
+    bool poll(const size_t rid)
+    {
+        if (iterations[rid] < number_of_buffers) return true;
+        return clEventDone(kernels_events[rid][iterations[rid] % number_of_buffers]);
+    }
+
+    bool notify_ready(const size_t rid,
+                      FReadyCallback ready)
+    {
+        if (iterations[rid] < number_of_buffers) {
+            ready(rid);
+            return true;
+        }
+        // the slot is free once its previous kernel completed
+        ready_requests[rid].rid = rid;
+        ready_requests[rid].ready = ready;
+        clCheckError(clSetEventCallback(kernels_events[rid][iterations[rid] % number_of_buffers],
+                                        CL_COMPLETE, FReadyRequest::on_complete, &ready_requests[rid]));
+        return true;
+    }
+
     void push(T * batch,
               const size_t batch_size,
               const size_t rid,
@@ -138,13 +278,41 @@ struct FSourceCopy : FSource<T>
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(buffers[rid][idx]), &buffers[rid][idx]));
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(_batch_size),       &_batch_size));
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(_last),             &_last));
-        clCheckError(clEnqueueTask(kernels_queues[rid], kernels[rid][idx], 1, &buffer_event, &kernels_events[rid][idx]));
+
+        // out of order, the kernel also waits for the previous one of the
+        // replica (NULL once get_batch found it completed)
+        const cl_event previous = kernels_events[rid][(it + number_of_buffers - 1) % number_of_buffers];
+        const cl_event wait_list[2] = {buffer_event, previous};
+        const cl_uint num_events = (out_of_order and previous) ? 2 : 1;
+        clCheckError(clEnqueueTask(kernels_queues[rid], kernels[rid][idx], num_events, wait_list, &kernels_events[rid][idx]));
         clFlush(kernels_queues[rid]);
-        clCheckError(clReleaseEvent(buffer_event));
+        if (this->breakdown) {
+            buffers_events[rid][idx] = buffer_event;    // released by get_batch
+        } else {
+            clCheckError(clReleaseEvent(buffer_event));
+        }
 
         iterations[rid]++;
     }
 
+    // both events are completed, all the counters are on the device clock
+    void record_stages(const size_t rid,
+                       cl_event write_event,
+                       cl_event kernel_event)
+    {
+        const cl_ulong w_queued = clEventProfilingTime(write_event, CL_PROFILING_COMMAND_QUEUED);
+        const cl_ulong w_start  = clEventProfilingTime(write_event, CL_PROFILING_COMMAND_START);
+        const cl_ulong w_end    = clEventProfilingTime(write_event, CL_PROFILING_COMMAND_END);
+        const cl_ulong k_start  = clEventProfilingTime(kernel_event, CL_PROFILING_COMMAND_START);
+        const cl_ulong k_end    = clEventProfilingTime(kernel_event, CL_PROFILING_COMMAND_END);
+
+        FHistogram * h = this->breakdown->source(rid).stages;
+        h[F_STAGE_WRITE_QUEUE].add(f_stage_ns(w_queued, w_start));
+        h[F_STAGE_WRITE].add(f_stage_ns(w_start, w_end));
+        h[F_STAGE_LAUNCH].add(f_stage_ns(w_end, k_start));
+        h[F_STAGE_SOURCE_KERNEL].add(f_stage_ns(k_start, k_end));
+    }
+
     void launch_kernels() {}
 
     void finish()
@@ -162,20 +330,20 @@ struct FSourceCopy : FSource<T>
         for (size_t rid = 0; rid < par; ++rid) {
 
             while (!batches_waiting_queue[rid].empty()) {
-                T * b = batches_waiting_queue[rid].front();
                 batches_waiting_queue[rid].pop();
-                free(b);
             }
+            f_free(batches_memory[rid]);
 
-            if (buffers_queues[rid]) clReleaseCommandQueue(buffers_queues[rid]);
             for (auto & b : buffers[rid]) {
                 if (b) clCheckError(clReleaseMemObject(b));
             }
+            for (auto & e : buffers_events[rid]) {
+                if (e) clCheckError(clReleaseEvent(e));
+            }
 
             for (auto & e : kernels_events[rid]) {
                 if (e) clCheckError(clReleaseEvent(e));
             }
-            if (kernels_queues[rid]) clReleaseCommandQueue(kernels_queues[rid]);
             for (auto & k : kernels[rid]) {
                 if (k) clReleaseKernel(k);
             }
@@ -191,6 +359,7 @@ struct FSourceHybrid : FSource<T>
 
     size_t max_batch_size;
     size_t number_of_buffers;
+    bool out_of_order;      // see OCL::out_of_order
 
     std::vector<size_t> iterations;
 
@@ -200,19 +369,23 @@ struct FSourceHybrid : FSource<T>
 
     std::vector< std::vector< clSharedBuffer<T> > > buffers;
 
+    std::vector<FReadyRequest> ready_requests;
 
     FSourceHybrid(OCL & ocl,
                   const size_t par,           // number of replicas
                   const size_t batch_size,    // max batch size
                   const size_t N)             // number of buffers used for N-Buffer technique
-    : ocl(ocl)
+    : FSource<T>(par)
+    , ocl(ocl)
     , par(par)
     , max_batch_size(next_pow2(batch_size))
     , number_of_buffers(N)
+    , out_of_order(ocl.out_of_order)
     , iterations(par, 0)
     , kernels(par, std::vector<cl_kernel>(number_of_buffers))
     , kernels_queues(par)
-    , kernels_events(par, std::vector<cl_event>(number_of_buffers))
+    , kernels_events(par, std::vector<cl_event>(number_of_buffers, NULL))
+    , ready_requests(par)
     {
         if (batch_size != max_batch_size) {
             std::cout << "FSourceHybrid: `batch_size` is rounded to the next power of 2 ("
@@ -220,7 +393,7 @@ struct FSourceHybrid : FSource<T>
         }
 
         for (size_t rid = 0; rid < par; ++rid) {
-            kernels_queues[rid] = ocl.createCommandQueue();
+            kernels_queues[rid] = ocl.getQueue(FQueueRole::KERNEL, "{{source_name}}_" + std::to_string(rid), out_of_order);
 
             std::vector< clSharedBuffer<T> > _buffs;
             for (size_t n = 0; n < number_of_buffers; ++n) {
@@ -243,7 +416,18 @@ struct FSourceHybrid : FSource<T>
         const size_t idx = iterations[rid] % number_of_buffers;
 
         if (iterations[rid] >= number_of_buffers) {
-            clCheckError(clWaitForEvents(1, &kernels_events[rid][idx]));
+            f_event_wait(kernels_events[rid][idx], this->backpressure[rid]);
+            if (this->breakdown) {
+                // no write: the kernel reads the batch from host memory
+                cl_event e = kernels_events[rid][idx];
+                const cl_ulong k_queued = clEventProfilingTime(e, CL_PROFILING_COMMAND_QUEUED);
+                const cl_ulong k_start  = clEventProfilingTime(e, CL_PROFILING_COMMAND_START);
+                const cl_ulong k_end    = clEventProfilingTime(e, CL_PROFILING_COMMAND_END);
+
+                FHistogram * h = this->breakdown->source(rid).stages;
+                h[F_STAGE_LAUNCH].add(f_stage_ns(k_queued, k_start));
+                h[F_STAGE_SOURCE_KERNEL].add(f_stage_ns(k_start, k_end));
+            }
             clCheckError(clReleaseEvent(kernels_events[rid][idx]));
             kernels_events[rid][idx] = NULL;
         }
@@ -251,6 +435,26 @@ struct FSourceHybrid : FSource<T>
         return buffers[rid][idx].ptr();
     }
 
+    bool poll(const size_t rid)
+    {
+        if (iterations[rid] < number_of_buffers) return true;
+        return clEventDone(kernels_events[rid][iterations[rid] % number_of_buffers]);
+    }
+
+    bool notify_ready(const size_t rid,
+                      FReadyCallback ready)
+    {
+        if (iterations[rid] < number_of_buffers) {
+            ready(rid);
+            return true;
+        }
+        ready_requests[rid].rid = rid;
+        ready_requests[rid].ready = ready;
+        clCheckError(clSetEventCallback(kernels_events[rid][iterations[rid] % number_of_buffers],
+                                        CL_COMPLETE, FReadyRequest::on_complete, &ready_requests[rid]));
+        return true;
+    }
+
     void push(T * batch,                // unused
               const size_t batch_size,
               const size_t rid,
@@ -267,7 +471,13 @@ struct FSourceHybrid : FSource<T>
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(*buffers[rid][idx].mem()), buffers[rid][idx].mem()));
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(_batch_size),              &_batch_size));
         clCheckError(clSetKernelArg(kernels[rid][idx], argi++, sizeof(_last),                    &_last));
-        clCheckError(clEnqueueTask(kernels_queues[rid], kernels[rid][idx], 0, NULL, &kernels_events[rid][idx]));
+
+        // out of order, the kernel waits for the previous one of the replica
+        // (NULL once get_batch found it completed)
+        const cl_event previous = kernels_events[rid][(iterations[rid] + number_of_buffers - 1) % number_of_buffers];
+        const cl_uint num_events = (out_of_order and previous) ? 1 : 0;
+        clCheckError(clEnqueueTask(kernels_queues[rid], kernels[rid][idx],
+                                   num_events, (num_events > 0 ? &previous : NULL), &kernels_events[rid][idx]));
         clFlush(kernels_queues[rid]);
 
         iterations[rid]++;
@@ -295,7 +505,6 @@ struct FSourceHybrid : FSource<T>
                 if (e) clCheckError(clReleaseEvent(e));
             }
 
-            if (kernels_queues[rid]) clReleaseCommandQueue(kernels_queues[rid]);
 
             for (auto & k : kernels[rid])
             if (k) clReleaseKernel(k);
@@ -324,7 +533,8 @@ struct FSourceShared : FSource<T>
                   const size_t par,         // number of replicas
                   const size_t batch_size,  // max batch size
                   const size_t N)           // number of buffers used for N-Buffer technique
-    : ocl(ocl)
+    : FSource<T>(par)
+    , ocl(ocl)
     , par(par)
     , max_batch_size(next_pow2(batch_size))
     , number_of_buffers(next_pow2(N))
@@ -344,7 +554,7 @@ struct FSourceShared : FSource<T>
 
         for (size_t rid = 0; rid < par; ++rid) {
             kernels[rid] = ocl.createKernel("{{source_name}}_" + std::to_string(rid));
-            kernels_queues[rid] = ocl.createCommandQueue();
+            kernels_queues[rid] = ocl.getQueue(FQueueRole::KERNEL, "{{source_name}}_" + std::to_string(rid));
 
             headers.push_back(clSharedBuffer<header_t>(ocl,
                                                        number_of_buffers,
@@ -370,12 +580,23 @@ struct FSourceShared : FSource<T>
     {
         const size_t idx = header_indexes[rid];
 
-        while (header_ready(headers[rid].ptr_volatile()[idx])) {
-            // SHARED_SLEEP_FUN();
-        };
+        if (header_ready(headers[rid].ptr_volatile()[idx])) {
+            const uint64_t start = current_time_ns();
+            while (header_ready(headers[rid].ptr_volatile()[idx])) {
+                // SHARED_SLEEP_FUN();
+            };
+            this->backpressure[rid].add_blocked(current_time_ns() - start);
+        }
         return &(buffers[rid].ptr()[idx * max_batch_size]);
     }
 
+    // the persistent kernel frees a slot by clearing its header: there is no
+    // command to be notified by, notify_ready only succeeds if poll does
+    bool poll(const size_t rid)
+    {
+        return !header_ready(headers[rid].ptr_volatile()[header_indexes[rid]]);
+    }
+
     void push(T * batch,                // unused
               const size_t batch_size,
               const size_t rid,
@@ -422,7 +643,6 @@ struct FSourceShared : FSource<T>
         }
 
         for (size_t rid = 0; rid < par; ++rid) {
-            if (kernels_queues[rid]) clReleaseCommandQueue(kernels_queues[rid]);
             if (kernels[rid]) clReleaseKernel(kernels[rid]);
         }
     }
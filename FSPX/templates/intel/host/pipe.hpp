@@ -20,6 +20,19 @@ enum struct FPipeTransfer {
     HYBRID
 };
 
+// Device counters of an operator replica (FApplication(instrument=True)).
+// Stalls are the non-blocking channel attempts that found the input empty
+// or the output full, roughly the cycles the replica spent waiting.
+struct FOperatorStats
+{
+    std::string name;
+    size_t replica;
+    cl_ulong tuples_in;
+    cl_ulong tuples_out;
+    cl_ulong read_stalls;
+    cl_ulong write_stalls;
+};
+
 {% macro create_node(n) -%}
 struct F{{ n.name }}
 {
@@ -31,13 +44,28 @@ struct F{{ n.name }}
     std::vector<cl_command_queue> kernel_queues;
     std::vector<cl_kernel> kernels;
 
+    {% if n.get_global_no_value_buffers() %}
+    // host queues of the buffers, shared by all of them (owned by OCL)
+    std::vector<cl_command_queue> buffer_queues;
+
+    {% endif %}
     {% for b in n.get_global_no_value_buffers() %}
     // {{ b.name }} buffer
-    std::vector<cl_command_queue> {{ b.get_queues_name() }};
     std::vector<cl_mem> {{ b.get_buffers_name() }};
+    {% if b.is_hot_swap() %}
+    std::vector<cl_mem> {{ b.get_shadows_name() }};
+    {% endif %}
 
     {% endfor %}
+    // writes of prepare_*_async, the kernels wait for them
+    std::vector<cl_event> pending_writes;
+
+
+    {% if n.instrument %}
+    // device counters, {{ n.STATS_FIELDS }} per replica, written at EOS
+    std::vector<cl_mem> stats_buffers;
 
+    {% endif %}
     F{{ n.name }}(OCL & ocl, const size_t par)
     : ocl(ocl)
     , par(par)
@@ -45,7 +73,7 @@ struct F{{ n.name }}
         name = "{{ n.name }}";
 
         for (size_t i = 0; i < par; ++i) {
-            kernel_queues.push_back(ocl.createCommandQueue());
+            kernel_queues.push_back(ocl.getQueue(FQueueRole::KERNEL, name + "_" + std::to_string(i)));
         }
 
         // Kernels
@@ -53,14 +81,31 @@ struct F{{ n.name }}
             kernels.push_back(ocl.createKernel(name + "_" + std::to_string(i)));
         }
 
+        {% if n.instrument %}
+        for (size_t i = 0; i < par; ++i) {
+            cl_int status;
+            cl_mem buff = clCreateBuffer(ocl.context,
+                                         CL_MEM_HOST_READ_ONLY | CL_MEM_WRITE_ONLY,
+                                         {{ n.STATS_FIELDS }} * sizeof(cl_ulong),
+                                         NULL, &status);
+            clCheckErrorMsg(status, "Failed to create stats buffer");
+
+            stats_buffers.push_back(buff);
+        }
+
+        {% endif %}
 
         // Create Buffers and their Queues
+        {% if n.get_global_no_value_buffers() %}
+        for (size_t i = 0; i < {{ n.get_buffer_queues_count() }}; ++i) {
+            buffer_queues.push_back(ocl.getQueue(FQueueRole::WRITE, i));
+        }
+
+        {% endif %}
         {% for b in n.get_global_no_value_buffers() %}
         // {{ b.name }} buffers
         {% set nums = ('par' if b.is_access_single() else 1) %}
         for (size_t i = 0; i < {{ nums }}; ++i) {
-            {{ b.get_queues_name() }}.push_back(ocl.createCommandQueue());
-
             cl_int status;
             cl_mem buff = clCreateBuffer(ocl.context,
                                          CL_MEM_HOST_WRITE_ONLY | {{ b.get_flags() }},
@@ -69,37 +114,88 @@ struct F{{ n.name }}
             clCheckErrorMsg(status, "Failed to create {{ b.name }}");
 
             {{ b.get_buffers_name() }}.push_back(buff);
+            {% if b.is_hot_swap() %}
+
+            cl_mem shadow = clCreateBuffer(ocl.context,
+                                           CL_MEM_HOST_WRITE_ONLY | CL_MEM_READ_ONLY,
+                                           {{ b.get_total_size() }} * sizeof({{ b.datatype }}),
+                                           NULL, &status);
+            clCheckErrorMsg(status, "Failed to create {{ b.name }} shadow");
+
+            {{ b.get_shadows_name() }}.push_back(shadow);
+            {% endif %}
         }
         {% endfor %}
     }
 
     {% for b in n.get_global_no_value_buffers() %}
 
-    void prepare_{{ b.name }}(const std::vector<{{ b.datatype }}> & data{{ ', size_t replica_id' if b.is_access_single() else ''}})
+    {% set rid = ('replica_id' if b.is_access_single() else '0') %}
+    {% set rid_param = (', size_t replica_id' if b.is_access_single() else '') %}
+    // Non-blocking, `data` must outlive the write. The kernels of
+    // launch_kernels wait for it, the caller releases the returned event.
+    cl_event prepare_{{ b.name }}_async(const std::vector<{{ b.datatype }}> & data{{ rid_param }})
+    {
+        cl_event event;
+        clCheckError(clEnqueueWriteBuffer({{ b.get_queues_name(rid) }},
+                                          {{ b.get_buffers_name(rid) }},
+                                          CL_FALSE, 0,
+                                          {{ b.get_total_size() }} * sizeof({{ b.datatype }}), data.data(),
+                                          0, NULL, &event));
+        clCheckError(clRetainEvent(event));
+        pending_writes.push_back(event);
+        return event;
+    }
+
+    void prepare_{{ b.name }}(const std::vector<{{ b.datatype }}> & data{{ rid_param }})
+    {
+        cl_event event = prepare_{{ b.name }}_async(data{{ ', replica_id' if b.is_access_single() else '' }});
+        clCheckError(clWaitForEvents(1, &event));
+        clCheckError(clReleaseEvent(event));
+    }
+    {% if b.is_hot_swap() %}
+
+    // Hot swap while the kernels run: stage_{{ b.name }} writes the new data in
+    // the shadow buffer, never read by the kernels, and swap_{{ b.name }} copies
+    // it over the live buffer on the device, once the staging write and
+    // `wait_list` (e.g., the end of a batch) are done. The copy is far shorter
+    // than a write from the host, yet tuples in flight during it may read
+    // either version. The caller releases the returned events. Both share the
+    // WRITE queue of the replica with the source, so `wait_list` must not hold
+    // events that depend on later writes (e.g., of the sink).
+    cl_event stage_{{ b.name }}(const std::vector<{{ b.datatype }}> & data{{ rid_param }})
     {
-        clCheckError(clEnqueueWriteBuffer({{ b.get_queues_name('replica_id' if b.is_access_single() else '0') }},
-                                          {{ b.get_buffers_name('replica_id' if b.is_access_single() else '0') }},
-                                          CL_TRUE, 0,
+        cl_event event;
+        clCheckError(clEnqueueWriteBuffer({{ b.get_queues_name(rid) }},
+                                          {{ b.get_shadows_name(rid) }},
+                                          CL_FALSE, 0,
                                           {{ b.get_total_size() }} * sizeof({{ b.datatype }}), data.data(),
-                                          0, NULL, NULL));
+                                          0, NULL, &event));
+        return event;
+    }
+
+    cl_event swap_{{ b.name }}({{ 'size_t replica_id, ' if b.is_access_single() else '' }}cl_uint num_events = 0, const cl_event * wait_list = NULL)
+    {
+        cl_event event;
+        clCheckError(clEnqueueCopyBuffer({{ b.get_queues_name(rid) }},
+                                         {{ b.get_shadows_name(rid) }},
+                                         {{ b.get_buffers_name(rid) }},
+                                         0, 0,
+                                         {{ b.get_total_size() }} * sizeof({{ b.datatype }}),
+                                         num_events, wait_list, &event));
+        return event;
     }
+    {% endif %}
     {% endfor %}
 
 
     void launch_kernels()
     {
-        // TODO: checking if all prepare() buffers are done
-        {% for b in n.get_global_no_value_buffers() %}
-        for (auto & q : {{ b.get_queues_name() }}) {
-            clFinish(q);
-        }
-        {% endfor %}
-
         {% for b in n.get_global_value_buffers() %}
         {{ b.get_declare_and_init() }};
         {% endfor %}
 
-        {% if n.get_global_buffers() | count > 0 %}
+        {% if n.get_global_buffers() | count > 0 or n.instrument %}
         for (size_t i = 0; i < par; ++i) {
             cl_uint argi = 0;
             {% for b in n.get_global_no_value_buffers() %}
@@ -108,12 +204,22 @@ struct F{{ n.name }}
             {% for b in n.get_global_value_buffers() %}
             clCheckError(clSetKernelArg(kernels[i], argi++, sizeof({{ b.datatype }}), &{{ b.name }}));
             {% endfor %}
+            {% if n.instrument %}
+            clCheckError(clSetKernelArg(kernels[i], argi++, sizeof(stats_buffers[i]), &stats_buffers[i]));
+            {% endif %}
         }
         {% endif %}
 
+        // the kernels start once the prepare_* writes are done
+        const cl_uint num_writes = pending_writes.size();
         for (size_t i = 0; i < par; ++i) {
-            clCheckError(clEnqueueTask(kernel_queues[i], kernels[i], 0, NULL, NULL));
+            clCheckError(clEnqueueTask(kernel_queues[i], kernels[i],
+                                       num_writes, (num_writes > 0 ? pending_writes.data() : NULL), NULL));
+        }
+        for (auto & e : pending_writes) {
+            clCheckError(clReleaseEvent(e));
         }
+        pending_writes.clear();
     }
 
     void finish()
@@ -123,26 +229,56 @@ struct F{{ n.name }}
         }
     }
 
+    {% if n.instrument %}
+    // valid once the kernels are finished
+    std::vector<FOperatorStats> read_stats()
+    {
+        std::vector<FOperatorStats> stats;
+        for (size_t i = 0; i < par; ++i) {
+            cl_ulong v[{{ n.STATS_FIELDS }}];
+            clCheckError(clEnqueueReadBuffer(kernel_queues[i], stats_buffers[i], CL_TRUE, 0,
+                                             sizeof(v), v, 0, NULL, NULL));
+            stats.push_back({name, i, v[0], v[1], v[2], v[3]});
+        }
+        return stats;
+    }
+
+    {% endif %}
     void clean()
     {
         finish();
 
+        {% if n.instrument %}
+        for (auto & b : stats_buffers) {
+            if (b) clCheckError(clReleaseMemObject(b));
+        }
+        {% endif %}
+
+        for (auto & e : pending_writes) {
+            clCheckError(clReleaseEvent(e));
+        }
+        pending_writes.clear();
+
         {% for b in n.get_global_no_value_buffers() %}
         for (auto & b : {{ b.get_buffers_name() }}) {
             if (b) clCheckError(clReleaseMemObject(b));
         }
-
-        for (auto & q : {{ b.get_queues_name() }}) {
-            if (q) clReleaseCommandQueue(q);
+        {% if b.is_hot_swap() %}
+        for (auto & b : {{ b.get_shadows_name() }}) {
+            if (b) clCheckError(clReleaseMemObject(b));
         }
+        {% endif %}
         {% endfor %}
+        {% if n.get_global_no_value_buffers() %}
 
-        for (auto & k : kernels) {
-            if (k) clReleaseKernel(k);
+        // the queues are pooled (released by OCL), pending writes end first
+        for (auto & q : buffer_queues) {
+            clFinish(q);
         }
+        {% endif %}
 
-        for (auto & q : kernel_queues) {
-            if (q) clReleaseCommandQueue(q);
+        for (auto & k : kernels) {
+            if (k) clReleaseKernel(k);
         }
     }
 
@@ -167,12 +303,22 @@ struct F{{ n.name }}
     std::vector<cl_command_queue> kernel_queues;
     std::vector<cl_kernel> kernels;
 
+    {% if n.get_global_no_value_buffers() %}
+    // host queues of the buffers, shared by all of them (owned by OCL)
+    std::vector<cl_command_queue> buffer_queues;
+
+    {% endif %}
     {% for b in n.get_global_no_value_buffers() %}
     // {{ b.name }} buffer
-    std::vector<cl_command_queue> {{ b.get_queues_name() }};
     std::vector<cl_mem> {{ b.get_buffers_name() }};
+    {% if b.is_hot_swap() %}
+    std::vector<cl_mem> {{ b.get_shadows_name() }};
+    {% endif %}
 
     {% endfor %}
+    // writes of prepare_*_async, the kernels wait for them
+    std::vector<cl_event> pending_writes;
+
 
     F{{ n.name }}(OCL & ocl, const size_t par)
     : ocl(ocl)
@@ -183,7 +329,7 @@ struct F{{ n.name }}
         sizes.resize(par);
 
         for (size_t i = 0; i < par; ++i) {
-            kernel_queues.push_back(ocl.createCommandQueue());
+            kernel_queues.push_back(ocl.getQueue(FQueueRole::KERNEL, name + "_" + std::to_string(i)));
         }
 
         // Kernels
@@ -192,12 +338,16 @@ struct F{{ n.name }}
         }
 
         // Create Buffers and their Queues
+        {% if n.get_global_no_value_buffers() %}
+        for (size_t i = 0; i < {{ n.get_buffer_queues_count() }}; ++i) {
+            buffer_queues.push_back(ocl.getQueue(FQueueRole::WRITE, i));
+        }
+
+        {% endif %}
         {% for b in n.get_global_no_value_buffers() %}
         // {{ b.name }} buffers
         {% set nums = ('par' if b.is_access_single() else 1) %}
         for (size_t i = 0; i < {{ nums }}; ++i) {
-            {{ b.get_queues_name() }}.push_back(ocl.createCommandQueue());
-
             cl_int status;
             cl_mem buff = clCreateBuffer(ocl.context,
                                          CL_MEM_HOST_WRITE_ONLY | {{ b.get_flags() }},
@@ -206,6 +356,16 @@ struct F{{ n.name }}
             clCheckErrorMsg(status, "Failed to create {{ b.name }}");
 
             {{ b.get_buffers_name() }}.push_back(buff);
+            {% if b.is_hot_swap() %}
+
+            cl_mem shadow = clCreateBuffer(ocl.context,
+                                           CL_MEM_HOST_WRITE_ONLY | CL_MEM_READ_ONLY,
+                                           {{ b.get_total_size() }} * sizeof({{ b.datatype }}),
+                                           NULL, &status);
+            clCheckErrorMsg(status, "Failed to create {{ b.name }} shadow");
+
+            {{ b.get_shadows_name() }}.push_back(shadow);
+            {% endif %}
         }
         {% endfor %}
     }
@@ -224,27 +384,68 @@ struct F{{ n.name }}
 
 
     {% for b in n.get_global_no_value_buffers() %}
-    void prepare_{{ b.name }}(const std::vector<{{ b.datatype }}> & data{{ ', size_t replica_id' if b.is_access_single() else ''}})
+    {% set rid = ('replica_id' if b.is_access_single() else '0') %}
+    {% set rid_param = (', size_t replica_id' if b.is_access_single() else '') %}
+    // Non-blocking, `data` must outlive the write. The kernels of
+    // launch_kernels wait for it, the caller releases the returned event.
+    cl_event prepare_{{ b.name }}_async(const std::vector<{{ b.datatype }}> & data{{ rid_param }})
     {
-        clCheckError(clEnqueueWriteBuffer({{ b.get_queues_name('replica_id' if b.is_access_single() else '0') }},
-                                          {{ b.get_buffers_name('replica_id' if b.is_access_single() else '0') }},
-                                          CL_TRUE, 0,
+        cl_event event;
+        clCheckError(clEnqueueWriteBuffer({{ b.get_queues_name(rid) }},
+                                          {{ b.get_buffers_name(rid) }},
+                                          CL_FALSE, 0,
                                           {{ b.get_total_size() }} * sizeof({{ b.datatype }}), data.data(),
-                                          0, NULL, NULL));
+                                          0, NULL, &event));
+        clCheckError(clRetainEvent(event));
+        pending_writes.push_back(event);
+        return event;
     }
 
+    void prepare_{{ b.name }}(const std::vector<{{ b.datatype }}> & data{{ rid_param }})
+    {
+        cl_event event = prepare_{{ b.name }}_async(data{{ ', replica_id' if b.is_access_single() else '' }});
+        clCheckError(clWaitForEvents(1, &event));
+        clCheckError(clReleaseEvent(event));
+    }
+    {% if b.is_hot_swap() %}
+
+    // Hot swap while the kernels run: stage_{{ b.name }} writes the new data in
+    // the shadow buffer, never read by the kernels, and swap_{{ b.name }} copies
+    // it over the live buffer on the device, once the staging write and
+    // `wait_list` (e.g., the end of a batch) are done. The copy is far shorter
+    // than a write from the host, yet tuples in flight during it may read
+    // either version. The caller releases the returned events. Both share the
+    // WRITE queue of the replica with the source, so `wait_list` must not hold
+    // events that depend on later writes (e.g., of the sink).
+    cl_event stage_{{ b.name }}(const std::vector<{{ b.datatype }}> & data{{ rid_param }})
+    {
+        cl_event event;
+        clCheckError(clEnqueueWriteBuffer({{ b.get_queues_name(rid) }},
+                                          {{ b.get_shadows_name(rid) }},
+                                          CL_FALSE, 0,
+                                          {{ b.get_total_size() }} * sizeof({{ b.datatype }}), data.data(),
+                                          0, NULL, &event));
+        return event;
+    }
+
+    cl_event swap_{{ b.name }}({{ 'size_t replica_id, ' if b.is_access_single() else '' }}cl_uint num_events = 0, const cl_event * wait_list = NULL)
+    {
+        cl_event event;
+        clCheckError(clEnqueueCopyBuffer({{ b.get_queues_name(rid) }},
+                                         {{ b.get_shadows_name(rid) }},
+                                         {{ b.get_buffers_name(rid) }},
+                                         0, 0,
+                                         {{ b.get_total_size() }} * sizeof({{ b.datatype }}),
+                                         num_events, wait_list, &event));
+        return event;
+    }
+    {% endif %}
+
     {% endfor %}
 
 
     void launch_kernels()
     {
-        // TODO: checking if all prepare() buffers are done
-        {% for b in n.get_global_no_value_buffers() %}
-        for (auto & q : {{ b.get_queues_name() }}) {
-            clFinish(q);
-        }
-        {% endfor %}
-
         {% for b in n.get_global_value_buffers() %}
         {{ b.get_declare_and_init() }};
         {% endfor %}
@@ -265,9 +466,16 @@ struct F{{ n.name }}
         }
         {% endif %}
 
+        // the kernels start once the prepare_* writes are done
+        const cl_uint num_writes = pending_writes.size();
         for (size_t i = 0; i < par; ++i) {
-            clCheckError(clEnqueueTask(kernel_queues[i], kernels[i], 0, NULL, NULL));
+            clCheckError(clEnqueueTask(kernel_queues[i], kernels[i],
+                                       num_writes, (num_writes > 0 ? pending_writes.data() : NULL), NULL));
         }
+        for (auto & e : pending_writes) {
+            clCheckError(clReleaseEvent(e));
+        }
+        pending_writes.clear();
     }
 
     void finish()
@@ -281,22 +489,31 @@ struct F{{ n.name }}
     {
         finish();
 
+        for (auto & e : pending_writes) {
+            clCheckError(clReleaseEvent(e));
+        }
+        pending_writes.clear();
+
         {% for b in n.get_global_no_value_buffers() %}
         for (auto & b : {{ b.get_buffers_name() }}) {
             if (b) clCheckError(clReleaseMemObject(b));
         }
-
-        for (auto & q : {{ b.get_queues_name() }}) {
-            if (q) clReleaseCommandQueue(q);
+        {% if b.is_hot_swap() %}
+        for (auto & b : {{ b.get_shadows_name() }}) {
+            if (b) clCheckError(clReleaseMemObject(b));
         }
+        {% endif %}
         {% endfor %}
+        {% if n.get_global_no_value_buffers() %}
 
-        for (auto & k : kernels) {
-            if (k) clReleaseKernel(k);
+        // the queues are pooled (released by OCL), pending writes end first
+        for (auto & q : buffer_queues) {
+            clFinish(q);
         }
+        {% endif %}
 
-        for (auto & q : kernel_queues) {
-            if (q) clReleaseCommandQueue(q);
+        for (auto & k : kernels) {
+            if (k) clReleaseKernel(k);
         }
     }
 
@@ -328,6 +545,12 @@ struct FPipeGraph
     volatile uint64_t time_start;
     volatile uint64_t time_stop;
 
+    // device counters of the instrumented operators, read by wait_and_stop
+    std::vector<FOperatorStats> stats;
+
+    // per-stage latency of the batches, nullptr if disabled
+    FLatencyBreakdown * breakdown = nullptr;
+
     FPipeGraph(OCL & ocl, FPipeTransfer transfer_type, std::vector<size_t> & pars{{ ", size_t source_batch_size, size_t source_buffers" if source else "" }}{{ ", size_t sink_batch_size, size_t sink_buffers" if sink else "" }})
     : ocl(ocl)
     {% if source %}
@@ -432,6 +655,19 @@ struct FPipeGraph
     }
     {% endif %}
 
+    // Must be called before start. The host stages are stamped here, the
+    // device ones by the source and sink nodes from their profiling events.
+    void set_breakdown(FLatencyBreakdown * b)
+    {
+        breakdown = b;
+        {% if source %}
+        source_node->set_breakdown(b);
+        {% endif %}
+        {% if sink %}
+        sink_node->set_breakdown(b);
+        {% endif %}
+    }
+
     void start()
     {
         // Run FPipeGraph
@@ -454,14 +690,52 @@ struct FPipeGraph
     {% if source %}
     SourceType_t * get_batch(const size_t rid)
     {
-        return source_node->get_batch(rid);
+        if (!breakdown) return source_node->get_batch(rid);
+
+        FBreakdownReplica & r = breakdown->source(rid);
+        const uint64_t t0 = current_time_ns();
+        SourceType_t * batch = source_node->get_batch(rid);
+        r.last_ns = current_time_ns();
+        r.stages[F_STAGE_SLOT_WAIT].add(r.last_ns - t0);
+        return batch;
+    }
+
+    // Non-blocking variants of get_batch, so that one thread can serve
+    // several replicas (or inputs) while the device is behind
+    SourceType_t * try_get_batch(const size_t rid)
+    {
+        SourceType_t * batch = source_node->try_get_batch(rid);
+        if (batch and breakdown) {
+            breakdown->source(rid).last_ns = current_time_ns();  // start of the fill
+        }
+        return batch;
     }
 
+    bool source_poll(const size_t rid)
+    {
+        return source_node->poll(rid);
+    }
+
+    bool notify_ready(const size_t rid,
+                      FReadyCallback ready)
+    {
+        return source_node->notify_ready(rid, ready);
+    }
+
+    // time the sources spent blocked on a full N-buffer, and the
+    // try_get_batch calls that found it full
+    uint64_t source_blocked_ns() const { return source_node->blocked_ns(); }
+    uint64_t source_full_polls() const { return source_node->full_polls(); }
+
     void push(SourceType_t * batch,
               const size_t batch_size,
               const size_t rid,
               const bool last = false)
     {
+        if (breakdown) {
+            FBreakdownReplica & r = breakdown->source(rid);
+            r.stages[F_STAGE_FILL].add(current_time_ns() - r.last_ns);
+        }
         source_node->push(batch, batch_size, rid, last);
     }
     {% endif %}
@@ -472,12 +746,30 @@ struct FPipeGraph
                      size_t * received,
                      bool * last)
     {
-        return sink_node->pop(rid, batch_size, received, last);
+        if (!breakdown) return sink_node->pop(rid, batch_size, received, last);
+
+        FBreakdownReplica & r = breakdown->sink(rid);
+        const uint64_t t0 = current_time_ns();
+        SinkType_t * batch = sink_node->pop(rid, batch_size, received, last);
+        r.last_ns = current_time_ns();
+        r.stages[F_STAGE_POP_WAIT].add(r.last_ns - t0);
+        return batch;
+    }
+
+    // true if pop(rid, batch_size, ...) would not block
+    bool sink_poll(const size_t rid,
+                   const size_t batch_size)
+    {
+        return sink_node->poll(rid, batch_size);
     }
 
     void put_batch(const size_t rid,
                    SinkType_t * batch)
     {
+        if (breakdown) {
+            FBreakdownReplica & r = breakdown->sink(rid);
+            r.stages[F_STAGE_HOLD].add(current_time_ns() - r.last_ns);
+        }
         sink_node->put_batch(rid, batch);
     }
     {% endif %}
@@ -498,6 +790,31 @@ struct FPipeGraph
         {% endif %}
 
         time_stop = current_time_ns();
+
+        stats.clear();
+        {% for n in nodes if n.instrument %}
+        for (auto & s : {{ n.name }}_node.read_stats()) stats.push_back(s);
+        {% endfor %}
+    }
+
+    void print_stats()
+    {
+        if (stats.empty()) return;
+
+        std::cout << COUT_HEADER << "operator"
+                  << std::setw(10) << "replica"
+                  << std::setw(13) << "tuples_in"
+                  << std::setw(13) << "tuples_out"
+                  << std::setw(13) << "read_stalls"
+                  << std::setw(13) << "write_stalls" << '\n';
+        for (auto & s : stats) {
+            std::cout << COUT_HEADER << s.name
+                      << std::setw(10) << s.replica
+                      << std::setw(13) << s.tuples_in
+                      << std::setw(13) << s.tuples_out
+                      << std::setw(13) << s.read_stalls
+                      << std::setw(13) << s.write_stalls << '\n';
+        }
     }
 
     uint64_t service_time_ns()
@@ -530,12 +847,13 @@ struct FPipeGraph
         sink_node->clean();
         {% endif %}
 
-        // deleting object of abstract class type which has non-virtual destructor will cause undefined behavior
         {% if source %}
-        // if (source_node) delete source_node;
+        delete source_node;
+        source_node = nullptr;
         {% endif %}
         {% if sink %}
-        // if (sink_node) delete sink_node;
+        delete sink_node;
+        sink_node = nullptr;
         {% endif %}
     }
 };
@@ -1,92 +1,53 @@
 inline void predictor_begin(const unsigned int num_states,
-                            const __global FLOAT_T * restrict trans_prob,
+                            const __global MODEL_VOLATILE FLOAT_T * restrict trans_prob,
+                            const __global MODEL_VOLATILE FLOAT_T * restrict rowsum,
                             __local predictor_t state[STATE_SIZE])
 {
     for (uint i = 0; i < STATE_SIZE; ++i) {
         state[i].win_elems = (win_size_t)0;
+        state[i].score_sum = (score_sum_t)0;
     }
 }
 
-#if FLOAT_T == float
-inline FLOAT_T get_local_metric(const win_state_t win[5],
-                               const __global FLOAT_T * restrict trans_prob,
-                               const uint num_states)
+// Transitions are scored in fixed point (SCORE_FRAC_BITS fractional bits), so
+// that the running sum of a window is exact: adding the entering transition
+// and subtracting the leaving one never drifts from the sum over the window.
+// This holds only for a fixed model: with HOT_SWAP_MODEL a swap would leave
+// in the sum transitions scored by the old model, so the window is summed
+// from scratch instead.
+#define SCORE_ONE ((FLOAT_T)(1UL << SCORE_FRAC_BITS))
+
+// sum over j != curr of trans_prob[prev][j] is rowsum[prev] - trans_prob[prev][curr]
+inline score_sum_t get_transition_score(const uint prev,
+                                        const uint curr,
+                                        const __global MODEL_VOLATILE FLOAT_T * restrict trans_prob,
+                                        const __global MODEL_VOLATILE FLOAT_T * restrict rowsum,
+                                        const uint num_states)
 {
-    FLOAT_T param0[WIN_DIM - 1];
-    const FLOAT_T param1 = WIN_DIM - 1;
-
-    #pragma unroll
-    for (uint i = 0; i < (WIN_DIM - 1); ++i) {
-        param0[i] = 0;
-        const uint prev = win[i];
-        const uint curr = win[i + 1];
-        for (uint j = 0; j < num_states; ++j) {
-            param0[i] += (j != curr ? trans_prob[prev * num_states + j] : 0);
-        }
-    }
-
-    FLOAT_T param0_sum = 0;
-    #pragma unroll
-    for (uint i = 0; i < (WIN_DIM - 1); ++i) {
-        param0_sum += param0[i];
-    }
-
-    return param0_sum / param1;
+    return (score_sum_t)((rowsum[prev] - trans_prob[prev * num_states + curr]) * SCORE_ONE);
 }
-#else
-inline FLOAT_T get_local_metric(const win_state_t win[5],
-                               const __global FLOAT_T * restrict trans_prob,
-                               const uint num_states)
-{
-    #define II_CYCLES   12
-    FLOAT_T shift_reg[II_CYCLES + 1];
-    #pragma unroll
-    for (uint i = 0; i < II_CYCLES + 1; ++i) {
-        shift_reg[i] = 0;
-    }
-
-    uint i = 0;
-    uint j = 0;
-    while (i < (WIN_DIM - 1)) {
-        uint prev = win[i];
-        uint curr = win[i + 1];
-        const FLOAT_T prob = trans_prob[prev * num_states + j];
-
-        shift_reg[II_CYCLES] = shift_reg[0] + (j != curr ? prob : 0);
-        #pragma unroll
-        for (uint s = 0; s < II_CYCLES; ++s) {
-            shift_reg[s] = shift_reg[s + 1];
-        }
-
-        j++;
-        if (j == num_states) {
-            j = 0;
-            i++;
-        }
-    }
-
-    FLOAT_T param0 = 0;
-    const FLOAT_T param1 = WIN_DIM - 1;
-
-    #pragma unroll
-    for (uint i = 0; i < II_CYCLES; ++i) {
-        param0 += shift_reg[i];
-    }
-
-    return param0 / param1;
-}
-#endif
 
 inline tuple_t predictor_function(input_t in, 
                                   const uint num_states,
-                                  const __global FLOAT_T * restrict trans_prob,
+                                  const __global MODEL_VOLATILE FLOAT_T * restrict trans_prob,
+                                  const __global MODEL_VOLATILE FLOAT_T * restrict rowsum,
                                   __local predictor_t * restrict state)
 {
     const uint idx = in.key / __PREDICTOR_PAR;
 
     // load state
     predictor_t p = state[idx];
-    
+
+#if !HOT_SWAP_MODEL
+    // the transition entering the window and, if it is full, the one leaving it
+    if (p.win_elems > 0) {
+        p.score_sum += get_transition_score(p.win[WIN_DIM - 1], in.state_id, trans_prob, rowsum, num_states);
+    }
+    if (p.win_elems == WIN_DIM) {
+        p.score_sum -= get_transition_score(p.win[0], p.win[1], trans_prob, rowsum, num_states);
+    }
+#endif
+
     // push_back(state_id)
     #pragma unroll
     for (int i = 0; i < (WIN_DIM - 1); ++i) {
@@ -99,13 +60,24 @@ inline tuple_t predictor_function(input_t in,
         p.win_elems++;
     }
 
+#if HOT_SWAP_MODEL
+    // every transition of the window with the current model
+    p.score_sum = (score_sum_t)0;
+    if (p.win_elems == WIN_DIM) {
+        #pragma unroll
+        for (int i = 0; i < (WIN_DIM - 1); ++i) {
+            p.score_sum += get_transition_score(p.win[i], p.win[i + 1], trans_prob, rowsum, num_states);
+        }
+    }
+#endif
+
     // update state
     state[idx] = p;
 
     // calculate score if there are WIN_DIM state_id (transactions)
     FLOAT_T score = 0;
     if (p.win_elems == WIN_DIM) {
-        score = get_local_metric(p.win, trans_prob, num_states);
+        score = ((FLOAT_T)p.score_sum / SCORE_ONE) / (WIN_DIM - 1);
     }
 
     // prepare output tuple
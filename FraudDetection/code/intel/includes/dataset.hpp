@@ -28,11 +28,14 @@ uint32_t get_state_id(const std::string val)
     return states.size();
 }
 
+// loads the model and its states, replacing the previous ones: the state
+// ids of a dataset loaded before are no longer valid
 template <typename T>
 std::vector<T> get_model(const std::string & model_filepath)
 {
     size_t num_states;
     std::vector<T>  state_trans_prob;
+    states.clear();
 
     std::ifstream file(model_filepath);
     if (file.is_open()) {
@@ -76,10 +79,28 @@ std::vector<T> get_model(const std::string & model_filepath)
     return state_trans_prob;
 }
 
+// sum of each row of the model, the predictor scores a transition prev->curr
+// as rowsum[prev] - trans_prob[prev][curr]
+template <typename T>
+std::vector<T> get_rowsum(const std::vector<T> & trans_prob,
+                          const size_t num_states)
+{
+    std::vector<T> rowsum(num_states, 0);
+    for (size_t i = 0; i < num_states; ++i) {
+        double sum = 0;
+        for (size_t j = 0; j < num_states; ++j) {
+            sum += trans_prob[i * num_states + j];
+        }
+        rowsum[i] = static_cast<T>(sum);
+    }
+    return rowsum;
+}
+
 std::vector<std::pair<std::string, std::string>> map_and_parse_dataset(const std::string & dataset_filepath)
 {
     size_t entity_unique_key = 0;
     std::vector<std::pair<std::string, std::string>> parsed_file;
+    entity_key_map.clear();
 
     std::ifstream file(dataset_filepath);
     if (file.is_open()) {
@@ -110,14 +131,14 @@ std::vector<std::pair<std::string, std::string>> map_and_parse_dataset(const std
 }
 
 template <typename T>
-std::vector<T> get_dataset(std::string dataset_filepath, int num_keys)
+f_vector<T> get_dataset(std::string dataset_filepath, int num_keys)
 {   
     std::uniform_int_distribution<std::mt19937::result_type> dist(0, num_keys-1);
     std::mt19937 rng;
     rng.seed(0);
 
     std::vector<std::pair<std::string, std::string>> parsed_file = map_and_parse_dataset(dataset_filepath);
-    std::vector<T> dataset;
+    f_vector<T> dataset;
     
     for (int i = 0; i < parsed_file.size()/4; ++i) {
         // create tuple
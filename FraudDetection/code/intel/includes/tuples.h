@@ -14,10 +14,20 @@
 #if defined(INTELFPGA_CL)
 #define win_state_t uint5_t
 #define win_size_t  uint7_t
+// fixed-point sum of the transition scores of a window: WIN_DIM of them
+// between the add and the subtract of an update, so with row sums <= 1 it
+// would fit up to 128, but win_elems (uint7_t) caps WIN_DIM at 127
+// (Benchmarks/sliding_score_check.cpp)
+#if SCORE_FRAC_BITS <= 32
+#define score_sum_t int40_t
+#else
+#define score_sum_t long
+#endif
 
 typedef struct {
     win_state_t win[WIN_DIM];
     win_size_t win_elems;
+    score_sum_t score_sum;
 } predictor_t;
 #endif
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <iostream>
+
+#include "../runtime/workload.hpp"
+
+// Synthetic transactions: every key (entity) walks the Markov chain of the
+// model (the one-step transition matrix of model.txt, as loaded by
+// get_model), starting from a random state. Each row is an alias table, so
+// a transition is one random word for any number of states.
+struct FDMarkovProcess
+{
+    struct State
+    {
+        uint32_t state;
+    };
+
+    std::vector<FAliasTable> rows;
+
+    template <typename F>
+    FDMarkovProcess(const std::vector<F> & trans_prob,
+                    const size_t num_states)
+    {
+        for (size_t i = 0; i < num_states; ++i) {
+            rows.push_back(FAliasTable(std::vector<double>(trans_prob.begin() + i * num_states,
+                                                           trans_prob.begin() + (i + 1) * num_states)));
+        }
+    }
+
+    void init(State & s,
+              const uint32_t key,
+              uint64_t & rng) const
+    {
+        (void)key;
+        s.state = static_cast<uint32_t>(((f_rand_next(rng) >> 32) * rows.size()) >> 32);
+    }
+
+    ALWAYS_INLINE void next(input_t & t,
+                            State & s,
+                            uint64_t & rng) const
+    {
+        s.state = rows[s.state].sample(f_rand_next(rng));
+        t.state_id = s.state;
+    }
+};
+
+// workload:KEYS,S over the model `trans_prob` (see get_model)
+template <typename F>
+std::unique_ptr< FInput<input_t> > get_workload(const FInputSpec & spec,
+                                               const std::vector<F> & trans_prob,
+                                               const size_t replicas)
+{
+    const size_t num_states = get_num_states();
+    if (num_states == 0 or trans_prob.size() != num_states * num_states) {
+        std::cout << "ERROR: the workload needs the model (model.txt)!\n";
+        exit(-1);
+    }
+    return std::unique_ptr< FInput<input_t> >(new FWorkloadInput<input_t, FDMarkovProcess>(FKeyDistribution(spec.keys, spec.s),
+                                                                                          FDMarkovProcess(trans_prob, num_states),
+                                                                                          replicas));
+}
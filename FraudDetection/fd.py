@@ -24,6 +24,7 @@ sink_par = 1
 transfer_t = FTransferMode.SHARED   # COPY, HYBRID or SHARED
 benchmark_t = 'throughput'          # latency or throughput
 precision_t = 'float'               # float or double
+hot_swap_model = False              # the model can be swapped while running (read uncached)
 
 transfer_char = ('s' if transfer_t == FTransferMode.SHARED else 'c')
 benchmark_char = ('t' if benchmark_t == 'throughput' else 'l')
@@ -39,8 +40,11 @@ constants = {'FLOAT_T': precision_t,
              'NUM_STATES': num_states,
              'MAX_LEN': max_len,
              'WIN_DIM': win_dim,
+             'SCORE_FRAC_BITS': (32 if precision_t == 'float' else 56),
              'THRESHOLD': str(threshold) + ('f' if precision_t == 'float' else ''),
-             'STATE_SIZE': state_size}
+             'STATE_SIZE': state_size,
+             'HOT_SWAP_MODEL': (1 if hot_swap_model else 0),
+             'MODEL_VOLATILE': ('volatile' if hot_swap_model else '')}
 
 source_node = FOperator('source',
                     source_par,
@@ -76,7 +80,13 @@ predictor_node.add_global_buffer('unsigned int',
 predictor_node.add_global_buffer(precision_t,
                                  'trans_prob',
                                  (num_states, num_states),
-                                 FBufferAccess.READ_ALL)
+                                 FBufferAccess.READ_ALL,
+                                 hot_swap=hot_swap_model)
+predictor_node.add_global_buffer(precision_t,
+                                 'rowsum',
+                                 num_states,
+                                 FBufferAccess.READ_ALL,
+                                 hot_swap=hot_swap_model)
 predictor_node.add_local_buffer('predictor_t',
                                 'state',
                                 state_size)
@@ -1,9 +1,18 @@
-inline void average_calculator_begin(__private int sizes[AVG_KEYS],
-                                     __local float windows[AVG_KEYS][WIN_DIM])
+inline void average_calculator_begin(__local average_t state[AVG_KEYS],
+                                     __local float windows[AVG_KEYS][WIN_DIM],
+                                     __private uint cache_keys[CACHE_DEPTH],
+                                     __private average_t cache_state[CACHE_DEPTH])
 {
     #pragma unroll
+    for (int i = 0; i < CACHE_DEPTH; ++i) {
+        cache_keys[i] = AVG_KEYS; // no key
+    }
+
     for (int i = 0; i < AVG_KEYS; ++i) {
-        sizes[i] = 0;
+        state[i].sum = 0;
+        state[i].fresh = 0;
+        state[i].head = 0;
+        state[i].size = 0;
     }
 
     for (int i = 0; i < AVG_KEYS; ++i) {
@@ -14,34 +23,64 @@ inline void average_calculator_begin(__private int sizes[AVG_KEYS],
     }
 }
 
+// The window of a key is a circular buffer with a running sum: a tuple adds
+// its value and subtracts the one it overwrites. To bound the float drift of
+// the running sum, `fresh` sums the values written since the window last
+// wrapped and, at the wrap, replaces the running sum (it is then the sum of
+// the whole window).
+//
+// The operator loop ignores the dependencies through `state` (ivdep, see
+// sd.py), so that back-to-back updates of a key keep II=1: the state read
+// may miss one of the last CACHE_DEPTH updates, still in the pipeline. The
+// forwarding cache keeps those updates, the newest one of the key wins.
 inline tuple_t average_calculator_function(input_t in,
-                                          __private int sizes[AVG_KEYS],
-                                          __local float windows[AVG_KEYS][WIN_DIM])
+                                          __local average_t state[AVG_KEYS],
+                                          __local float windows[AVG_KEYS][WIN_DIM],
+                                          __private uint cache_keys[CACHE_DEPTH],
+                                          __private average_t cache_state[CACHE_DEPTH])
 {
     const uint idx = in.key / __AVERAGE_CALCULATOR_PAR;
     const float val = in.property_value;
 
-#undef STATEMENT
-#define STATEMENT(i) N = 1.0 / (sizes[i] == WIN_DIM ? sizes[i] : ++sizes[i]);
+    average_t a = state[idx];
+    #pragma unroll
+    for (int i = CACHE_DEPTH - 1; i >= 0; --i) {
+        if (cache_keys[i] == idx) {
+            a = cache_state[i];
+        }
+    }
+
+    const float old = windows[idx][a.head]; // 0 until the window is full
+    windows[idx][a.head] = val;
 
-    float N = 0.0;
-    SWITCH_CASE(idx, 63)
+    a.sum += val - old;
+    a.fresh += val;
+    if (a.size < WIN_DIM) {
+        a.size++;
+    }
+    if (a.head == WIN_DIM - 1) {
+        a.head = 0;
+        a.sum = a.fresh;
+        a.fresh = 0;
+    } else {
+        a.head++;
+    }
+    state[idx] = a;
 
-    float sum = 0.0;
     #pragma unroll
-    for (uint i = 0; i < WIN_DIM - 1; ++i) {
-        windows[idx][i] = windows[idx][i + 1];
-        sum += windows[idx][i];
+    for (int i = CACHE_DEPTH - 1; i > 0; --i) {
+        cache_keys[i] = cache_keys[i - 1];
+        cache_state[i] = cache_state[i - 1];
     }
-    windows[idx][WIN_DIM - 1] = val;
-    sum += val;
+    cache_keys[0] = idx;
+    cache_state[0] = a;
 
     tuple_t out;
     out.key = in.key;
     out.property_value = in.property_value;
-    out.incremental_average = sum * N;
+    out.incremental_average = a.sum * (1.0f / a.size);
 
-#ifdef MEASURE_LATENCY
+#if MEASURE_LATENCY
     out.timestamp = in.timestamp;
 #endif
     return out;
@@ -4,34 +4,45 @@
 #include <thread>
 #include <unistd.h>
 #include <atomic>
+#include <chrono>
+#include <memory>
 
-#ifdef MEASURE_LATENCY
+#include "metric/report.hpp"
+
+#include "includes/pipe.hpp"
+
+// after pipe.hpp, which defines MEASURE_LATENCY (common/constants.h)
+#if MEASURE_LATENCY
 #include "metric/sampler.hpp"
 #include "metric/metric_group.hpp"
 #endif
 
-#include "includes/pipe.hpp"
 #include "includes/dataset.hpp"
+#include "includes/workload.hpp"
+#include "runtime/fill.hpp"
+#include "runtime/rate.hpp"
+#include "runtime/sweep.hpp"
+#include "runtime/monitor.hpp"
+#include "runtime/counters.hpp"
+#include "runtime/latency.hpp"
+#include "runtime/breakdown.hpp"
+#include "runtime/reactor.hpp"
+#include "runtime/consumer.hpp"
+#include "runtime/input.hpp"
 
 
 struct sink_batch
 {
-    uint32_t source_timestamp;
-    uint32_t sink_timestamp;
+    FLatencyStamp source_timestamp;
+    FLatencyStamp sink_timestamp;
 
-    sink_batch(uint32_t source_timestamp, uint32_t sink_timestamp)
+    sink_batch(FLatencyStamp source_timestamp, FLatencyStamp sink_timestamp)
     : source_timestamp(source_timestamp)
     , sink_timestamp(sink_timestamp)
     {}
 };
 
 
-std::atomic<uint64_t> sent_tuples;          // total number of tuples sent by all sources
-std::atomic<uint64_t> sent_batches;         // total number of batches sent by all sources
-std::atomic<uint64_t> received_tuples;      // total number of tuples received by all sinks
-std::atomic<uint64_t> received_batches;     // total number of batches received by all sinks
-
-
 bool update_done(const uint64_t app_start_time,
                  const uint64_t app_run_time)
 {
@@ -39,98 +50,219 @@ bool update_done(const uint64_t app_start_time,
 }
 
 
+// One source replica. In the default mode each replica runs its blocking
+// loop on its own thread, in reactor mode FReactor steps it.
 template <typename SourceType_t, typename SinkType_t = SourceType_t>
-void source_thread(FPipeGraph<SourceType_t, SinkType_t> & pipe,
-                   std::vector<SourceType_t> & dataset,
-                   const size_t batch_size,
-                   const uint64_t app_start_time,
-                   const uint64_t app_run_time,
-                   const size_t tid)
+struct SourceReplica : FReactorTask
 {
-    const std::string start_str = "Source " + std::to_string(tid) + " started!\n";
-    std::cout << start_str;
-
-    uint64_t _sent_tuples = 0;
-    uint64_t _sent_batches = 0;
-
-    size_t next_tuple_idx = 0;
-    bool done = update_done(app_start_time, app_run_time);
-    while (!done) {
-        SourceType_t * batch = pipe.get_batch(tid);
-
-#ifdef MEASURE_LATENCY
-        const uint32_t _timestamp = static_cast<uint32_t>(current_time_ns() - app_start_time);
-        for (size_t i = 0; i < batch_size; ++i) {
-            SourceType_t t = dataset[next_tuple_idx];
-            t.timestamp = _timestamp;
-            batch[i] = t;
-            next_tuple_idx = (next_tuple_idx + 1) % dataset.size();
-        }
+    FPipeGraph<SourceType_t, SinkType_t> & pipe;
+    FInput<SourceType_t> & input;
+    const size_t batch_size;
+    const uint64_t app_start_time;
+    const uint64_t app_run_time;
+    FReplicaCounters & counters;
+    const size_t tid;
+
+    FRatePacer pacer;
+    bool finished;
+    bool paced;         // reactor: the pacer released the next batch at paced_ns
+    uint64_t paced_ns;
+    SourceType_t * pending;     // reactor: the batch being filled, obtained after waiting pending_wait_ns
+    uint64_t pending_wait_ns;
+
+    SourceReplica(FPipeGraph<SourceType_t, SinkType_t> & pipe,
+                  FInput<SourceType_t> & input,
+                  const size_t batch_size,
+                  const FRateProfile & rate_profile,
+                  const size_t sources,
+                  const uint64_t app_start_time,
+                  const uint64_t app_run_time,
+                  FReplicaCounters & counters,
+                  const size_t tid)
+    : pipe(pipe)
+    , input(input)
+    , batch_size(batch_size)
+    , app_start_time(app_start_time)
+    , app_run_time(app_run_time)
+    , counters(counters)
+    , tid(tid)
+    , pacer(rate_profile, sources, app_start_time, batch_size)
+    , finished(update_done(app_start_time, app_run_time))
+    , paced(false)
+    , paced_ns(0)
+    , pending(nullptr)
+    , pending_wait_ns(0)
+    {}
+
+    // fills a free batch from the input, without blocking if `nonblocking`:
+    // false while its tuples are still arriving
+    bool fill(SourceType_t * batch,
+              const bool nonblocking,
+              size_t * n)
+    {
+#if MEASURE_LATENCY
+        const FInputStamp _stamp = {offsetof(SourceType_t, timestamp), f_latency_stamp(app_start_time), app_start_time};
+        const FInputStamp * stamp = &_stamp;
 #else
-        for (size_t i = 0; i < batch_size; ++i) {
-            batch[i] = dataset[next_tuple_idx];
-            next_tuple_idx = (next_tuple_idx + 1) % dataset.size();
-        }
+        const FInputStamp * stamp = nullptr;
 #endif
+        if (nonblocking) {
+            return input.try_fill(batch, batch_size, tid, stamp, n);
+        }
+        *n = input.fill(batch, batch_size, tid, stamp);
+        return true;
+    }
 
-        done = update_done(app_start_time, app_run_time);
-        pipe.push(batch, batch_size, tid, done);
+    // pushes a batch of `n` tuples, obtained after waiting `wait_ns`
+    void send(SourceType_t * batch,
+              const size_t n,
+              const uint64_t wait_ns)
+    {
+        // a finite input (e.g., a socket) ends the stream early
+        finished = (n < batch_size) or update_done(app_start_time, app_run_time);
+        pipe.push(batch, n, tid, finished);
+
+        // published per batch, so that a monitor can sample them during the run
+        counters.add(n, wait_ns);
+    }
+
+    void run()
+    {
+        const std::string start_str = "Source " + std::to_string(tid) + " started!\n";
+        std::cout << start_str;
+
+        while (!finished) {
+            pacer.wait(batch_size);
+            const uint64_t _wait_start = current_time_ns();
+            SourceType_t * batch = pipe.get_batch(tid);
+            const uint64_t _wait_ns = current_time_ns() - _wait_start;
+            size_t n = 0;
+            fill(batch, false, &n);
+            send(batch, n, _wait_ns);
+        }
 
-        _sent_tuples += batch_size;
-        _sent_batches++;
+        const std::string end_str = "Source " + std::to_string(tid) + " ending!\n";
+        std::cout << end_str;
     }
 
-    sent_tuples.fetch_add(_sent_tuples);
-    sent_batches.fetch_add(_sent_batches);
+    bool try_step()
+    {
+        if (finished) return false;
+        if (!pending) {
+            if (!paced) {
+                if (!pacer.try_take(batch_size)) return false;
+                paced = true;
+                paced_ns = current_time_ns();
+            }
+            pending = pipe.try_get_batch(tid);
+            if (!pending) return false;
+            paced = false;
+            pending_wait_ns = current_time_ns() - paced_ns;
+        }
+        size_t n = 0;
+        if (!fill(pending, true, &n)) return false;
+        send(pending, n, pending_wait_ns);
+        pending = nullptr;
+        return true;
+    }
 
-    const std::string end_str = "Source " + std::to_string(tid) + " ending!\n";
-    std::cout << end_str;
-}
+    bool done() const { return finished; }
+};
 
 
 template <typename SourceType_t, typename SinkType_t = SourceType_t>
-void sink_thread(FPipeGraph<SourceType_t, SinkType_t> & pipe,
-                 std::vector<sink_batch> & results,
-                 const size_t batch_size,
-                 const uint64_t app_start_time,
-                 const size_t sampling_rate,
-                 const size_t tid)
+struct SinkReplica : FReactorTask
 {
-    const std::string start_str = "Sink " + std::to_string(tid) + " started!\n";
-    std::cout << start_str;
-
-    uint64_t _received_tuples = 0;
-    uint64_t _received_batches = 0;
+    FPipeGraph<SourceType_t, SinkType_t> & pipe;
+    FResultConsumers<SinkType_t> & consumers;
+    std::vector<sink_batch> & results;
+    const size_t batch_size;
+    const uint64_t app_start_time;
+    const size_t sampling_rate;
+    FLatencyWindow & latency_window;
+    FReplicaCounters & counters;
+    const size_t tid;
+
+    bool last;
+
+    SinkReplica(FPipeGraph<SourceType_t, SinkType_t> & pipe,
+                FResultConsumers<SinkType_t> & consumers,
+                std::vector<sink_batch> & results,
+                const size_t batch_size,
+                const uint64_t app_start_time,
+                const size_t sampling_rate,
+                FLatencyWindow & latency_window,
+                FReplicaCounters & counters,
+                const size_t tid)
+    : pipe(pipe)
+    , consumers(consumers)
+    , results(results)
+    , batch_size(batch_size)
+    , app_start_time(app_start_time)
+    , sampling_rate(sampling_rate)
+    , latency_window(latency_window)
+    , counters(counters)
+    , tid(tid)
+    , last(false)
+    {}
 
-    bool last = false;
-    while (!last) {
+    // pops a batch, that is ready unless the caller blocks for it
+    void receive()
+    {
         size_t received = 0;
+        const uint64_t _wait_start = current_time_ns();
         SinkType_t * batch = pipe.pop(tid, batch_size, &received, &last);
+        const uint64_t _wait_ns = current_time_ns() - _wait_start;
 
         if (!last and received <= 0) {
             const std::string nothing_str = "\n\nSink " + std::to_string(tid) + " has received NOTHING!\n";
             std::cout << nothing_str;
         } else {
-            #ifdef MEASURE_LATENCY
-            const uint32_t _timestamp = static_cast<uint32_t>(current_time_ns() - app_start_time);
+            #if MEASURE_LATENCY
+            const FLatencyStamp _timestamp = f_latency_stamp(app_start_time);
             for (size_t i = 0; i < received; i += sampling_rate) {
                 results.emplace_back(batch[i].timestamp, _timestamp);
             }
+            if (received > 0) {
+                latency_window.add(f_latency_ns(batch[0].timestamp, _timestamp));
+            }
+            #else
+            (void)latency_window;
             #endif
         }
 
-        pipe.put_batch(tid, batch);
+        // the batch goes back to the pipe once the consumers released it
+        consumers.deliver(tid, batch, received, last);
+        consumers.give_back(pipe, tid);
 
-        _received_tuples += received;
-        _received_batches++;
+        counters.add(received, _wait_ns);
     }
 
-    received_tuples.fetch_add(_received_tuples);
-    received_batches.fetch_add(_received_batches);
+    void run()
+    {
+        const std::string start_str = "Sink " + std::to_string(tid) + " started!\n";
+        std::cout << start_str;
 
-    const std::string end_str = "Sink " + std::to_string(tid) + " ending!\n";
-    std::cout << end_str;
-}
+        while (!last) {
+            consumers.wait_slot(pipe, tid);
+            receive();
+        }
+        consumers.drain(pipe, tid);
+
+        const std::string end_str = "Sink " + std::to_string(tid) + " ending!\n";
+        std::cout << end_str;
+    }
+
+    bool try_step()
+    {
+        const bool given_back = consumers.give_back(pipe, tid) > 0;
+        if (last or consumers.full(tid) or !pipe.sink_poll(tid, batch_size)) return given_back;
+        receive();
+        return true;
+    }
+
+    bool done() const { return last and consumers.empty(tid); }
+};
 
 
 std::string get_aocx_filepath(const std::vector<size_t> & pars,
@@ -142,7 +274,7 @@ std::string get_aocx_filepath(const std::vector<size_t> & pars,
     if (transfer_type == FPipeTransfer::HYBRID) ss << "c";
     if (transfer_type == FPipeTransfer::SHARED) ss << "s";
 
-#ifdef MEASURE_LATENCY
+#if MEASURE_LATENCY
     ss << "l";
 #else
     ss << "t";
@@ -163,145 +295,138 @@ std::string get_aocx_filepath(const std::vector<size_t> & pars,
 }
 
 
-int main(int argc, char * argv[])
+// Runs the application once on an already initialized `ocl` and returns
+// the metrics of the run, in the order they are reported
+std::vector<std::pair<std::string, double>> run_once(OCL & ocl,
+                                                     const FPipeTransfer transfer_type,
+                                                     std::vector<size_t> & pars,
+                                                     const size_t source_buffers,
+                                                     const size_t source_batch_size,
+                                                     const size_t sink_buffers,
+                                                     const size_t sink_batch_size,
+                                                     FInput<input_t> & input,
+                                                     const FRateProfile & rate_profile,
+                                                     const uint64_t app_run_time_ns,
+                                                     const size_t sampling_rate,
+                                                     const size_t monitor_ms,
+                                                     const std::string & monitor_endpoint,
+                                                     const std::string & monitor_filepath,
+                                                     const std::string & monitor_label,
+                                                     const size_t reactor_threads)
 {
-    const std::string program_name = std::string(argv[0]);
-
-    int platform_id = 0;
-    int device_id = 0;
-    std::string aocx_filepath = "device.aocx";
-    size_t source_buffers = 2;
-    size_t source_batch_size = 1024;
-    size_t sink_buffers = 2;
-    size_t sink_batch_size = 1024;
-    std::string dataset_filepath = "./dataset.dat";
-    std::string pipe_pars = "1,1,1,1";
-    size_t source_par = 1;
-    size_t average_calculator_par = 1;
-    size_t spike_detector_par = 1;
-    size_t sink_par = 1;
-    std::string transfer_type_str = "copy"; // "copy", "shared", "hybrid"
-    FPipeTransfer transfer_type = FPipeTransfer::COPY;
-    size_t app_run_time_s = 5;
-    std::string results_filepath = "";
-    size_t sampling_rate = 16;
-
-    argc--;
-    argv++;
-
-    int argi = 0;
-    if (argc > argi) platform_id       = atoi(argv[argi++]);
-    if (argc > argi) device_id         = atoi(argv[argi++]);
-    if (argc > argi) source_buffers    = atoi(argv[argi++]);
-    if (argc > argi) source_batch_size = atoi(argv[argi++]);
-    if (argc > argi) sink_buffers      = atoi(argv[argi++]);
-    if (argc > argi) sink_batch_size   = atoi(argv[argi++]);
-    if (argc > argi) dataset_filepath  = std::string(argv[argi++]);
-    if (argc > argi) pipe_pars         = std::string(argv[argi++]);
-    if (argc > argi) transfer_type_str = std::string(argv[argi++]);
-    if (argc > argi) app_run_time_s    = atoi(argv[argi++]);
-    if (argc > argi) results_filepath  = std::string(argv[argi++]);
-    if (argc > argi) sampling_rate     = atoi(argv[argi++]);
-
-    std::vector<size_t> pars;
-    std::stringstream ss(pipe_pars);
-    for (size_t i; ss >> i;) {
-        pars.push_back(i);
-        if (ss.peek() == ',')
-            ss.ignore();
-    }
-    if (pars.size() != 4) {
-        std::cout << "ERROR: `pipe_pars` is not provided properly!\n";
-        exit(-1);
-    }
-    source_par = pars[0];
-    average_calculator_par = pars[1];
-    spike_detector_par = pars[2];
-    sink_par = pars[3];
-
-    // parsing `transfer_type_str`
-    if (transfer_type_str.compare("copy") == 0)   transfer_type = FPipeTransfer::COPY;
-    if (transfer_type_str.compare("shared") == 0) transfer_type = FPipeTransfer::SHARED;
-    if (transfer_type_str.compare("hybrid") == 0) transfer_type = FPipeTransfer::HYBRID;
-
-    if (sampling_rate == 0) sampling_rate = 1;
-
-    aocx_filepath = get_aocx_filepath(pars, transfer_type);
-
-    std::cout << COUT_HEADER << "platform_id: "       << COUT_INTEGER << platform_id       << '\n'
-              << COUT_HEADER << "device_id: "         << COUT_INTEGER << device_id         << '\n'
-              << COUT_HEADER << "aocx_filepath: "     << aocx_filepath                     << '\n'
-              << COUT_HEADER << "source_buffers: "    << COUT_INTEGER << source_buffers    << '\n'
-              << COUT_HEADER << "source_batch_size: " << COUT_INTEGER << source_batch_size << '\n'
-              << COUT_HEADER << "sink_buffers: "      << COUT_INTEGER << sink_buffers      << '\n'
-              << COUT_HEADER << "sink_batch_size: "   << COUT_INTEGER << sink_batch_size   << '\n'
-              << COUT_HEADER << "dataset_filepath: "  << dataset_filepath                  << '\n'
-              << COUT_HEADER << "transfer_type_str: " << transfer_type_str                 << '\n'
-              << COUT_HEADER << "app_run_time_s: "    << COUT_INTEGER << app_run_time_s    << '\n'
-              << COUT_HEADER << "results_filepath: "  << results_filepath                  << '\n'
-              << COUT_HEADER << "sampling_rate: "     << COUT_INTEGER << sampling_rate     << '\n'
-              << std::endl;
-
-    // OpenCL init
-    OCL ocl;
-    ocl.init(aocx_filepath, platform_id, device_id, true);
-
-    std::cout << "Device Temperature: " << clGetTemperature(ocl.device) << " degrees C" << std::endl;
-
+    const size_t source_par = pars[0];
+    const size_t sink_par = pars[3];
+
+    FCounters source_counters(source_par);
+    FCounters sink_counters(sink_par);
+
+    // startup: queues, kernels (cached by the OCL), buffers and the first launches
+    const size_t kernels_created = ocl.kernels_created;
+    const size_t kernels_reused = ocl.kernels_reused;
+    const size_t queues_created = ocl.queues_created;
+    const size_t queues_reused = ocl.queues_reused;
+    const double queues_ms = ocl.queues_ms;
+    volatile uint64_t startup_start_ns = current_time_ns();
     FPipeGraph<input_t, tuple_t> pipe(ocl, transfer_type, pars, source_batch_size, source_buffers, sink_batch_size, sink_buffers);
+    const double startup_pipe_ms = (current_time_ns() - startup_start_ns) * 1.0e-6;
+
+    // queues taken from the pool of OCL instead of created, at the mean
+    // creation time measured so far
+    const size_t startup_queues_created = ocl.queues_created - queues_created;
+    const size_t startup_queues_reused = ocl.queues_reused - queues_reused;
+    const double startup_queues_ms = ocl.queues_ms - queues_ms;
+    const double startup_queues_saved_ms = ocl.queues_created ? startup_queues_reused * ocl.queues_ms / ocl.queues_created : 0;
+
+#if MEASURE_LATENCY
+    FLatencyBreakdown breakdown(source_par, sink_par);
+    pipe.set_breakdown(&breakdown);
+#endif
 
-    std::vector<input_t> dataset = get_dataset<input_t>(dataset_filepath, TEMPERATURE);
-    std::cout << dataset.size() << " tuples loaded!" << std::endl;
+    // consumers.add(...) forwards the results (see runtime/consumer.hpp)
+    FResultConsumers<tuple_t> consumers(sink_par, sink_buffers);
+
+    FLatencyWindow latency_window;
+    FMonitor monitor(monitor_ms, monitor_endpoint, monitor_filepath, monitor_label,
+                     [&]() {
+                         FMonitorSample s;
+                         s.time_ns = current_time_ns();
+                         s.sent_tuples = source_counters.tuples();
+                         s.sent_batches = source_counters.batches();
+                         s.received_tuples = sink_counters.tuples();
+                         s.received_batches = sink_counters.batches();
+                         s.source_wait_ns = source_counters.wait_ns();
+                         s.sink_wait_ns = sink_counters.wait_ns();
+                         return s;
+                     },
+#if MEASURE_LATENCY
+                     &latency_window,
+#else
+                     nullptr,
+#endif
+                     sizeof(input_t), sizeof(tuple_t));
 
-    uint64_t app_run_time_ns = app_run_time_s * uint64_t(1000000000);
+    volatile uint64_t launch_start_ns = current_time_ns();
     pipe.start();
     volatile uint64_t app_start_time_ns = current_time_ns();
-
-    std::vector<std::thread> source_threads(source_par);
-    for (size_t i = 0; i < source_par; ++i) {
-        source_threads[i] = std::thread(source_thread<input_t, tuple_t>,
-                                        std::ref(pipe),
-                                        std::ref(dataset),
-                                        source_batch_size,
-                                        app_start_time_ns,
-                                        app_run_time_ns,
-                                        i);
-    }
+    const double startup_launch_ms = (app_start_time_ns - launch_start_ns) * 1.0e-6;
+    monitor.start();
 
     std::vector<sink_batch> results;
     results.reserve(1 << 16);
 
-    std::vector<std::thread> sink_threads(sink_par);
-    for (size_t i = 0; i < sink_par; ++i) {
-        sink_threads[i] = std::thread(sink_thread<input_t, tuple_t>,
-                                      std::ref(pipe),
-                                      std::ref(results),
-                                      sink_batch_size,
-                                      app_start_time_ns,
-                                      sampling_rate,
-                                      i);
-    }
+    // every run starts from the first tuple of the input
+    input.rewind();
 
-    pipe.wait_and_stop();
-    
+    std::vector< std::unique_ptr< SourceReplica<input_t, tuple_t> > > sources;
     for (size_t i = 0; i < source_par; ++i) {
-        source_threads[i].join();
+        sources.emplace_back(new SourceReplica<input_t, tuple_t>(pipe,
+                                                                 input,
+                                                                 source_batch_size,
+                                                                 rate_profile,
+                                                                 source_par,
+                                                                 app_start_time_ns,
+                                                                 app_run_time_ns,
+                                                                 source_counters[i],
+                                                                 i));
     }
+
+    std::vector< std::unique_ptr< SinkReplica<input_t, tuple_t> > > sinks;
     for (size_t i = 0; i < sink_par; ++i) {
-        sink_threads[i].join();
+        sinks.emplace_back(new SinkReplica<input_t, tuple_t>(pipe,
+                                                             consumers,
+                                                             results,
+                                                             sink_batch_size,
+                                                             app_start_time_ns,
+                                                             sampling_rate,
+                                                             latency_window,
+                                                             sink_counters[i],
+                                                             i));
     }
 
+    // one thread per replica, or `reactor_threads` threads over all of them
+    std::vector<std::thread> threads;
+    FReactor reactor(reactor_threads);
+    if (reactor_threads == 0) {
+        for (auto & r : sources) threads.emplace_back(&SourceReplica<input_t, tuple_t>::run, r.get());
+        for (auto & r : sinks)   threads.emplace_back(&SinkReplica<input_t, tuple_t>::run, r.get());
+    } else {
+        for (auto & r : sources) reactor.add(r.get());
+        for (auto & r : sinks)   reactor.add(r.get());
+        reactor.start();
+    }
 
-#ifdef MEASURE_LATENCY
-    // computing latency for each tuple
-    util::Sampler latency_sampler(0);
-    if (results.size() > 0) { 
-        for (sink_batch & b : results) {
-            latency_sampler.add(b.sink_timestamp - b.source_timestamp);
-        }
+    pipe.wait_and_stop();
+
+    for (auto & t : threads) {
+        t.join();
     }
-    util::metric_group.add("latency_ns", latency_sampler);
-#endif
+    reactor.join();
+    monitor.stop();
+
+    const uint64_t sent_tuples = source_counters.tuples();
+    const uint64_t sent_batches = source_counters.batches();
+    const uint64_t received_tuples = sink_counters.tuples();
+    const uint64_t received_batches = sink_counters.batches();
 
     double elapsed_time_ms_pipe = pipe.service_time_ms();
     double elapsed_time_s_pipe = pipe.service_time_s();
@@ -310,6 +435,7 @@ int main(int argc, char * argv[])
     double bandwidth_sink = (received_tuples * sizeof(tuple_t)) / elapsed_time_s_pipe;
     double bandwidth = bandwidth_source + bandwidth_sink;
     double drop_ratio = 1.0 - (received_tuples / double(sent_tuples));
+    double source_blocked_ms = pipe.source_blocked_ns() * 1.0e-6;   // waiting for a free N-buffer slot
     // Print results
     std::cout << COUT_HEADER << "Elapsed Time (pipe): " << COUT_FLOAT   << elapsed_time_ms_pipe         << " ms\n"
               << COUT_HEADER << "Sent Tuples: "         << COUT_INTEGER << sent_tuples                  << " tuples\n"
@@ -321,84 +447,352 @@ int main(int argc, char * argv[])
               << COUT_HEADER << "Bandwidth Sink(s): "   << COUT_FLOAT   << bandwidth_sink / (1 << 20)   << " MiB/s\n"
               << COUT_HEADER << "Bandwidth: "           << COUT_FLOAT   << bandwidth / (1 << 20)        << " MiB/s\n"
               << COUT_HEADER << "Drop Ratio: "          << COUT_FLOAT   << drop_ratio                   << "\n"
+              << COUT_HEADER << "Source Blocked: "      << COUT_FLOAT   << source_blocked_ms            << " ms\n"
+              << COUT_HEADER << "Startup (pipe): "      << COUT_FLOAT   << startup_pipe_ms              << " ms\n"
+              << COUT_HEADER << "Startup (launch): "    << COUT_FLOAT   << startup_launch_ms            << " ms\n"
+              << COUT_HEADER << "Queues Created: "      << COUT_INTEGER << startup_queues_created       << " (" << COUT_FLOAT << startup_queues_ms << " ms)\n"
+              << COUT_HEADER << "Queues Reused: "       << COUT_INTEGER << startup_queues_reused        << " (~" << COUT_FLOAT << startup_queues_saved_ms << " ms saved)\n"
               << std::endl;
 
-    if (!results_filepath.empty()) {
+    std::vector<std::pair<std::string, double>> metrics = {
+        {"time_ms",          elapsed_time_ms_pipe},
+        {"throughput",       throughput},
+        {"source_bandwidth", bandwidth_source},
+        {"sink_bandwidth",   bandwidth_sink},
+        {"total_bandwidth",  bandwidth},
+        {"drop_ratio",       drop_ratio},
+        {"source_blocked_ms", source_blocked_ms}
+    };
+
+    // kernel objects created by this pipe, the others are reused from the OCL
+    metrics.emplace_back("startup_pipe_ms",         startup_pipe_ms);
+    metrics.emplace_back("startup_launch_ms",       startup_launch_ms);
+    metrics.emplace_back("startup_kernels_created", ocl.kernels_created - kernels_created);
+    metrics.emplace_back("startup_kernels_reused",  ocl.kernels_reused - kernels_reused);
+    metrics.emplace_back("startup_queues_created",  startup_queues_created);
+    metrics.emplace_back("startup_queues_reused",   startup_queues_reused);
+    metrics.emplace_back("startup_queues_ms",       startup_queues_ms);
+    metrics.emplace_back("startup_queues_saved_ms", startup_queues_saved_ms);
+
+    // share of the reactor passes that found no replica ready
+    if (reactor_threads > 0) {
+        const double reactor_idle_ratio = reactor.passes() ? double(reactor.idle_passes()) / reactor.passes() : 0;
+        std::cout << COUT_HEADER << "Reactor Idle Ratio: " << COUT_FLOAT << reactor_idle_ratio << "\n" << std::endl;
+        metrics.emplace_back("reactor_idle_ratio", reactor_idle_ratio);
+    }
+
+    // device counters, only if the pipe is generated with instrument=True
+    pipe.print_stats();
+    for (auto & s : pipe.stats) {
+        const std::string prefix = s.name + "_" + std::to_string(s.replica) + "_";
+        metrics.emplace_back(prefix + "tuples_in",    s.tuples_in);
+        metrics.emplace_back(prefix + "tuples_out",   s.tuples_out);
+        metrics.emplace_back(prefix + "read_stalls",  s.read_stalls);
+        metrics.emplace_back(prefix + "write_stalls", s.write_stalls);
+    }
+
+#if MEASURE_LATENCY
+    // computing latency for each tuple
+    util::Sampler latency_sampler(0);
+    for (sink_batch & b : results) {
+        latency_sampler.add(f_latency_ns(b.source_timestamp, b.sink_timestamp));
+    }
+    util::metric_group.add("latency_ns", latency_sampler);
+    auto latency = util::metric_group.get_metric("latency_ns");
+
+    metrics.emplace_back("latency_samples", latency.getSamplesSize());
+    if (latency.getSamplesSize() > 0) {
+        metrics.emplace_back("latency_mean", latency.getMean());
+        metrics.emplace_back("latency_p05", latency.getPercentile(0.05));
+        metrics.emplace_back("latency_p25", latency.getPercentile(0.25));
+        metrics.emplace_back("latency_p50", latency.getPercentile(0.5));
+        metrics.emplace_back("latency_p75", latency.getPercentile(0.75));
+        metrics.emplace_back("latency_p95", latency.getPercentile(0.95));
+        metrics.emplace_back("clock_read_ns", FClockCalibration::measure().read_ns);
+    }
 
-#ifdef MEASURE_LATENCY
-        auto latency = util::metric_group.get_metric("latency_ns");
+    breakdown.print();
+    breakdown.append_metrics(metrics);
 #endif
 
-        char temp[256];
-        std::string current_path = (getcwd(temp, sizeof(temp)) ? std::string( temp ) : std::string("None")) + program_name;
-
-
-        const char delim = '\t';
-        bool write_header_flag = (!fileExists(results_filepath));
-        std::ofstream outfile;
-        outfile.open(results_filepath, std::ios_base::app);
-        if (outfile) {
-            if (write_header_flag) {
-
-                outfile << "path"               << delim
-                    << "source_par"             << delim
-                    << "average_calculator_par" << delim
-                    << "spike_detector_par"     << delim
-                    << "sink_par"               << delim
-                    << "transfer_type"          << delim
-                    << "source_buffers"         << delim
-                    << "source_batch_size"      << delim
-                    << "sink_buffers"           << delim
-                    << "sink_batch_size"        << delim
-                    << "time_ms"                << delim
-                    << "throughput"             << delim
-                    << "source_bandwidth"       << delim
-                    << "sink_bandwidth"         << delim
-                    << "total_bandwidth"        << delim
-                    << "drop_ratio"             << delim
-#ifdef MEASURE_LATENCY
-                    << "latency_samples"        << delim
-                    << "latency_mean"           << delim
-                    << "latency_p05"            << delim
-                    << "latency_p25"            << delim
-                    << "latency_p50"            << delim
-                    << "latency_p75"            << delim
-                    << "latency_p95"
+    pipe.clean();
+
+    return metrics;
+}
+
+
+int main(int argc, char * argv[])
+{
+    int platform_id = 0;
+    int device_id = 0;
+    std::string aocx_filepath = "device.aocx";
+    size_t source_buffers = 2;
+    size_t source_batch_size = 1024;
+    size_t sink_buffers = 2;
+    size_t sink_batch_size = 1024;
+    std::string dataset_filepath = "./dataset.dat";
+    std::string pipe_pars = "1,1,1,1";
+    std::string transfer_type_str = "copy"; // "copy", "shared", "hybrid"
+    FPipeTransfer transfer_type = FPipeTransfer::COPY;
+    size_t app_run_time_s = 5;
+    std::string results_filepath = "";
+    size_t sampling_rate = 16;
+    std::string alloc_policy_str = "default"; // default, thp, hugetlb
+    std::string rate_profile_str = "max"; // max, const:R, step:S,R0,R1,..., sin:M,A,P, burst:B,P,ON,P, replay:X
+    size_t warmup = 0;
+    size_t repetitions = 1;
+    double cooldown_s = 0;
+    size_t monitor_ms = 0; // 0 disables the monitor
+    std::string monitor_endpoint = "none"; // none, http:PORT, unix:PATH
+    std::string monitor_filepath = "";
+    size_t reactor_threads = 0; // 0: one thread per source/sink replica
+    std::string input_str = "replay"; // replay, mmap:PATH, uniform:KEYS, zipf:KEYS,S, tcp:PORT[,local], unix:PATH[,local], workload:KEYS,S[,SPIKE_RATE[,SPIKE_SIZE[,STEP]]]
+    std::string queue_order_str = "in"; // in, out: out-of-order queues for the copy transfers
+
+    argc--;
+    argv++;
+
+    // `host sweep <spec_filepath>` runs every configuration of the spec (see
+    // runtime/sweep.hpp), each key overrides the positional argument with the
+    // same name. Otherwise, the positional arguments describe a single run.
+    FSweep sweep;
+    if (argc > 1 and std::string(argv[0]).compare("sweep") == 0) {
+        if (!sweep.load(argv[1])) {
+            exit(-1);
+        }
+    } else {
+        int argi = 0;
+        if (argc > argi) platform_id       = atoi(argv[argi++]);
+        if (argc > argi) device_id         = atoi(argv[argi++]);
+        if (argc > argi) source_buffers    = atoi(argv[argi++]);
+        if (argc > argi) source_batch_size = atoi(argv[argi++]);
+        if (argc > argi) sink_buffers      = atoi(argv[argi++]);
+        if (argc > argi) sink_batch_size   = atoi(argv[argi++]);
+        if (argc > argi) dataset_filepath  = std::string(argv[argi++]);
+        if (argc > argi) pipe_pars         = std::string(argv[argi++]);
+        if (argc > argi) transfer_type_str = std::string(argv[argi++]);
+        if (argc > argi) app_run_time_s    = atoi(argv[argi++]);
+        if (argc > argi) results_filepath  = std::string(argv[argi++]);
+        if (argc > argi) sampling_rate     = atoi(argv[argi++]);
+        if (argc > argi) alloc_policy_str  = std::string(argv[argi++]);
+        if (argc > argi) rate_profile_str  = std::string(argv[argi++]);
+        if (argc > argi) monitor_ms        = atoi(argv[argi++]);
+        if (argc > argi) monitor_endpoint  = std::string(argv[argi++]);
+        if (argc > argi) monitor_filepath  = std::string(argv[argi++]);
+        if (argc > argi) reactor_threads   = atoi(argv[argi++]);
+        if (argc > argi) input_str         = std::string(argv[argi++]);
+        if (argc > argi) queue_order_str   = std::string(argv[argi++]);
+    }
+
+    // OpenCL context, dataset and arrival times are kept across the
+    // configurations, and reloaded only when they change
+    OCL ocl;
+    std::string ocl_aocx_filepath = "";
+    int ocl_platform_id = -1;
+    int ocl_device_id = -1;
+
+    f_vector<input_t> dataset;
+    std::string dataset_loaded_filepath = "";
+    std::vector<uint64_t> arrivals_ns;
+
+    const std::vector<FSweep::Config> configs = sweep.configs();
+    for (size_t c = 0; c < configs.size(); ++c) {
+        const FSweep::Config & config = configs[c];
+
+        const int c_platform_id            = FSweep::get_size(config, "platform_id", platform_id);
+        const int c_device_id              = FSweep::get_size(config, "device_id", device_id);
+        const size_t c_source_buffers      = FSweep::get_size(config, "source_buffers", source_buffers);
+        const size_t c_source_batch_size   = FSweep::get_size(config, "source_batch_size", source_batch_size);
+        const size_t c_sink_buffers        = FSweep::get_size(config, "sink_buffers", sink_buffers);
+        const size_t c_sink_batch_size     = FSweep::get_size(config, "sink_batch_size", sink_batch_size);
+        const std::string c_dataset_path   = FSweep::get(config, "dataset", dataset_filepath);
+        const std::string c_pipe_pars      = FSweep::get(config, "pars", pipe_pars);
+        const std::string c_transfer_str   = FSweep::get(config, "transfer", transfer_type_str);
+        const size_t c_app_run_time_s      = FSweep::get_size(config, "app_run_time_s", app_run_time_s);
+        const std::string c_results_prefix = FSweep::get(config, "results", results_filepath);
+        size_t c_sampling_rate             = FSweep::get_size(config, "sampling_rate", sampling_rate);
+        const std::string c_alloc_policy   = FSweep::get(config, "alloc_policy", alloc_policy_str);
+        const std::string c_rate_profile   = FSweep::get(config, "rate_profile", rate_profile_str);
+        const size_t c_warmup              = FSweep::get_size(config, "warmup", warmup);
+        const size_t c_repetitions         = FSweep::get_size(config, "repetitions", repetitions);
+        const double c_cooldown_s          = FSweep::get_double(config, "cooldown_s", cooldown_s);
+        const size_t c_monitor_ms          = FSweep::get_size(config, "monitor_ms", monitor_ms);
+        const std::string c_monitor_ep     = FSweep::get(config, "monitor_endpoint", monitor_endpoint);
+        const std::string c_monitor_path   = FSweep::get(config, "monitor_file", monitor_filepath);
+        const size_t c_reactor_threads     = FSweep::get_size(config, "reactor_threads", reactor_threads);
+        const std::string c_input          = FSweep::get(config, "input", input_str);
+        const std::string c_queue_order    = FSweep::get(config, "queue_order", queue_order_str);
+
+        std::vector<size_t> pars;
+        std::stringstream ss(c_pipe_pars);
+        for (size_t i; ss >> i;) {
+            pars.push_back(i);
+            if (ss.peek() == ',')
+                ss.ignore();
+        }
+        if (pars.size() != 4) {
+            std::cout << "ERROR: `pipe_pars` is not provided properly!\n";
+            exit(-1);
+        }
+
+        // parsing `transfer_type_str`
+        transfer_type = FPipeTransfer::COPY;
+        if (c_transfer_str.compare("copy") == 0)   transfer_type = FPipeTransfer::COPY;
+        if (c_transfer_str.compare("shared") == 0) transfer_type = FPipeTransfer::SHARED;
+        if (c_transfer_str.compare("hybrid") == 0) transfer_type = FPipeTransfer::HYBRID;
+
+        if (c_sampling_rate == 0) c_sampling_rate = 1;
+
+        // parsing `input_str`
+        FInputSpec input_spec;
+        if (!input_spec.parse(c_input)) {
+            std::cout << "ERROR: `input` must be one of replay, mmap:PATH, uniform:KEYS, zipf:KEYS,S, tcp:PORT[,local], unix:PATH[,local], workload:KEYS,S[,...]!\n";
+            exit(-1);
+        }
+
+        // parsing `queue_order_str`
+        if (c_queue_order.compare("in") != 0 and c_queue_order.compare("out") != 0) {
+            std::cout << "ERROR: `queue_order` must be one of in, out!\n";
+            exit(-1);
+        }
+
+        // parsing `alloc_policy_str`, batches, rings and the dataset are allocated with it
+        if (!f_alloc_set_policy(c_alloc_policy)) {
+            std::cout << "ERROR: `alloc_policy` must be one of default, thp, hugetlb!\n";
+            exit(-1);
+        }
+
+        // parsing `rate_profile_str`
+        FRateProfile rate_profile;
+        if (!rate_profile.parse(c_rate_profile)) {
+            std::cout << "ERROR: `rate_profile` is not provided properly!\n";
+            exit(-1);
+        }
+
+        if (!FMonitor::valid_endpoint(c_monitor_ep)) {
+            std::cout << "ERROR: `monitor_endpoint` must be one of none, http:PORT, unix:PATH!\n";
+            exit(-1);
+        }
+
+        aocx_filepath = get_aocx_filepath(pars, transfer_type);
+
+        std::cout << COUT_HEADER << "configuration: "     << COUT_INTEGER << (c + 1) << " / " << configs.size() << '\n'
+                  << COUT_HEADER << "platform_id: "       << COUT_INTEGER << c_platform_id       << '\n'
+                  << COUT_HEADER << "device_id: "         << COUT_INTEGER << c_device_id         << '\n'
+                  << COUT_HEADER << "aocx_filepath: "     << aocx_filepath                       << '\n'
+                  << COUT_HEADER << "source_buffers: "    << COUT_INTEGER << c_source_buffers    << '\n'
+                  << COUT_HEADER << "source_batch_size: " << COUT_INTEGER << c_source_batch_size << '\n'
+                  << COUT_HEADER << "sink_buffers: "      << COUT_INTEGER << c_sink_buffers      << '\n'
+                  << COUT_HEADER << "sink_batch_size: "   << COUT_INTEGER << c_sink_batch_size   << '\n'
+                  << COUT_HEADER << "dataset_filepath: "  << c_dataset_path                      << '\n'
+                  << COUT_HEADER << "transfer_type_str: " << c_transfer_str                      << '\n'
+                  << COUT_HEADER << "app_run_time_s: "    << COUT_INTEGER << c_app_run_time_s    << '\n'
+                  << COUT_HEADER << "results_prefix: "    << c_results_prefix                    << '\n'
+                  << COUT_HEADER << "sampling_rate: "     << COUT_INTEGER << c_sampling_rate     << '\n'
+                  << COUT_HEADER << "alloc_policy: "      << c_alloc_policy                      << '\n'
+                  << COUT_HEADER << "rate_profile: "      << c_rate_profile                      << '\n'
+                  << COUT_HEADER << "warmup: "            << COUT_INTEGER << c_warmup            << '\n'
+                  << COUT_HEADER << "repetitions: "       << COUT_INTEGER << c_repetitions       << '\n'
+                  << COUT_HEADER << "monitor_ms: "        << COUT_INTEGER << c_monitor_ms        << '\n'
+                  << COUT_HEADER << "monitor_endpoint: "  << c_monitor_ep                        << '\n'
+                  << COUT_HEADER << "monitor_file: "      << c_monitor_path                      << '\n'
+                  << COUT_HEADER << "reactor_threads: "   << COUT_INTEGER << c_reactor_threads   << '\n'
+                  << COUT_HEADER << "input: "             << c_input                             << '\n'
+                  << COUT_HEADER << "queue_order: "       << c_queue_order                       << '\n'
+                  << std::endl;
+
+        // OpenCL init, the context and the binaries already loaded are kept
+        double startup_context_ms = 0;
+        double startup_program_ms = 0;
+        if (aocx_filepath != ocl_aocx_filepath or c_platform_id != ocl_platform_id or c_device_id != ocl_device_id) {
+            ocl.init(aocx_filepath, c_platform_id, c_device_id, true);
+            startup_context_ms = ocl.context_ms;
+            startup_program_ms = ocl.program_ms;
+            ocl_aocx_filepath = aocx_filepath;
+            ocl_platform_id = c_platform_id;
+            ocl_device_id = c_device_id;
+
+            std::cout << "Device Temperature: " << clGetTemperature(ocl.device) << " degrees C" << std::endl;
+        }
+        ocl.out_of_order = (c_queue_order.compare("out") == 0);
+
+        if (c_dataset_path != dataset_loaded_filepath) {
+            dataset = get_dataset<input_t>(c_dataset_path, TEMPERATURE);
+            dataset_loaded_filepath = c_dataset_path;
+            arrivals_ns.clear();
+            std::cout << dataset.size() << " tuples loaded!" << std::endl;
+        }
+        std::unique_ptr< FInput<input_t> > input = (input_spec.kind == FInputKind::WORKLOAD)
+                                                 ? get_workload(input_spec, pars.front())
+                                                 : f_make_input(input_spec, dataset, c_source_batch_size, pars.front());
+
+        if (rate_profile.kind == FRateKind::REPLAY) {
+            if (arrivals_ns.empty()) {
+                arrivals_ns = get_arrivals(c_dataset_path);
+            }
+            if (arrivals_ns.empty()) {
+                std::cout << "ERROR: " << c_dataset_path << " has no arrival times to replay!\n";
+                exit(-1);
+            }
+            rate_profile.arrivals_ns = arrivals_ns;
+        }
+
+        util::Report report;
+        report.config("app",               "sd");
+#if MEASURE_LATENCY
+        report.config("benchmark",         "lat");
+#else
+        report.config("benchmark",         "thr");
 #endif
-                    << '\n';
+        report.config("precision",         (sizeof(FLOAT_T) == sizeof(float)) ? "float" : "double");
+        report.config("transfer",          c_transfer_str);
+        report.config("pars",              c_pipe_pars);
+        report.config("source_buffers",    std::to_string(c_source_buffers));
+        report.config("source_batch_size", std::to_string(c_source_batch_size));
+        report.config("sink_buffers",      std::to_string(c_sink_buffers));
+        report.config("sink_batch_size",   std::to_string(c_sink_batch_size));
+        report.config("rate_profile",      c_rate_profile);
+        report.config("alloc_policy",      c_alloc_policy);
+        report.config("app_run_time_s",    std::to_string(c_app_run_time_s));
+        report.config("reactor_threads",   std::to_string(c_reactor_threads));
+        report.config("queue_order",       c_queue_order);
+        report.config("input",             c_input);
+
+        const uint64_t app_run_time_ns = c_app_run_time_s * uint64_t(1000000000);
+        for (size_t r = 0; r < c_warmup + c_repetitions; ++r) {
+            if (r > 0 and c_cooldown_s > 0) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(c_cooldown_s));
             }
 
-            outfile << current_path                         << delim
-                    << source_par                           << delim
-                    << average_calculator_par               << delim
-                    << spike_detector_par                   << delim
-                    << sink_par                             << delim
-                    << transfer_type_str                    << delim
-                    << COUT_INTEGER << source_buffers       << delim
-                    << COUT_INTEGER << source_batch_size    << delim
-                    << COUT_INTEGER << sink_buffers         << delim
-                    << COUT_INTEGER << sink_batch_size      << delim
-                    << COUT_FLOAT   << elapsed_time_ms_pipe << delim
-                    << COUT_INTEGER << (uint64_t)throughput << delim
-                    << COUT_FLOAT   << bandwidth_source     << delim
-                    << COUT_FLOAT   << bandwidth_sink       << delim
-                    << COUT_FLOAT   << bandwidth            << delim
-                    << COUT_FLOAT   << drop_ratio           << delim;
-#ifdef MEASURE_LATENCY
-            outfile << COUT_INTEGER << latency.getSamplesSize()    << delim
-                    << COUT_INTEGER << (uint64_t)latency.getMean() << delim;
-            for (auto p : {0.05, 0.25, 0.5, 0.75, 0.95}) {
-                outfile << COUT_INTEGER << (uint64_t)latency.getPercentile(p) << delim;
+            std::cout << ((r < c_warmup) ? "Warm-up " : "Repetition ")
+                      << ((r < c_warmup) ? r + 1 : r - c_warmup + 1) << std::endl;
+
+            auto metrics = run_once(ocl, transfer_type, pars,
+                                    c_source_buffers, c_source_batch_size,
+                                    c_sink_buffers, c_sink_batch_size,
+                                    *input, rate_profile, app_run_time_ns, c_sampling_rate,
+                                    c_monitor_ms, c_monitor_ep, c_monitor_path,
+                                    std::to_string(c + 1) + "." + std::to_string(r + 1),
+                                    c_reactor_threads);
+            // measured once per configuration (0 if the OCL was reused), in every repetition
+            metrics.emplace_back("startup_context_ms", startup_context_ms);
+            metrics.emplace_back("startup_program_ms", startup_program_ms);
+            if (r >= c_warmup) {
+                report.repetition();
+                for (auto & m : metrics) {
+                    report.add(m.first, m.second);
+                }
             }
-#endif
-            outfile << '\n';
         }
 
-        outfile.close();
+        if (!c_results_prefix.empty()) {
+            report.write(f_results_prefix(c_results_prefix));
+        }
     }
 
-    pipe.clean();
-    ocl.clean();
+    if (!ocl_aocx_filepath.empty()) {
+        ocl.clean();
+    }
 
     return 0;
 }
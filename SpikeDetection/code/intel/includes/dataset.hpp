@@ -4,6 +4,9 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
 
 
 // information contained in each record in the dataset
@@ -52,11 +55,11 @@ std::vector<record_t> load_datasaet(const std::string & file_path)
 }
 
 template <typename T>
-std::vector<T> get_dataset(const std::string & dataset_filepath,
-                           const monitored_field field)
+f_vector<T> get_dataset(const std::string & dataset_filepath,
+                        const monitored_field field)
 {
     std::vector<record_t> parsed_file = load_datasaet(dataset_filepath);
-    std::vector<T> dataset;
+    f_vector<T> dataset;
     dataset.reserve(parsed_file.size());
 
     for (const auto & record : parsed_file) {
@@ -71,4 +74,30 @@ std::vector<T> get_dataset(const std::string & dataset_filepath,
         dataset.push_back(t);
     }
     return dataset;
-}
\ No newline at end of file
+}
+
+// arrival time (ns) of each record of get_dataset, from the first one;
+// records are not strictly ordered in the file, so times never go backwards
+std::vector<uint64_t> get_arrivals(const std::string & dataset_filepath)
+{
+    std::vector<record_t> parsed_file = load_datasaet(dataset_filepath);
+    std::vector<uint64_t> arrivals;
+    arrivals.reserve(parsed_file.size());
+
+    double first_s = 0;
+    double last_s = 0;
+    for (const auto & record : parsed_file) {
+        struct tm t = {};
+        double seconds = 0;
+        sscanf(std::get<DATE_FIELD>(record).c_str(), "%d-%d-%d", &t.tm_year, &t.tm_mon, &t.tm_mday);
+        sscanf(std::get<TIME_FIELD>(record).c_str(), "%d:%d:%lf", &t.tm_hour, &t.tm_min, &seconds);
+        t.tm_year -= 1900;
+        t.tm_mon -= 1;
+        const double time_s = timegm(&t) + seconds;
+
+        if (arrivals.empty()) first_s = last_s = time_s;
+        last_s = std::max(last_s, time_s);
+        arrivals.push_back(static_cast<uint64_t>((last_s - first_s) * 1e9));
+    }
+    return arrivals;
+}
@@ -8,11 +8,20 @@
     #define UINT_T uint32_t
 #endif
 
+#if defined(INTELFPGA_CL)
+typedef struct {
+    float sum;      // running sum of the window
+    float fresh;    // sum of the values written since the window last wrapped
+    uint head;      // next slot of the window
+    uint size;      // values in the window, up to WIN_DIM
+} average_t;
+#endif
+
 typedef struct {
     UINT_T key;
     float property_value;
 
-#ifdef MEASURE_LATENCY
+#if MEASURE_LATENCY
     UINT_T timestamp;
 #endif
 } input_t;
@@ -21,7 +30,7 @@ typedef struct {
     UINT_T key;
     float property_value;
     float incremental_average;
-#ifdef MEASURE_LATENCY
+#if MEASURE_LATENCY
     UINT_T timestamp;
 #endif
 } tuple_t;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "../runtime/workload.hpp"
+
+// Synthetic sensor readings: every key (device) is a mean-reverting random
+// walk around its own base value, with spikes injected at `spike_rate`. A
+// spike is `spike_size` times the current value away from it and is not fed
+// back into the walk, so that it does not shift the average of the following
+// readings: with spike_size well above THRESHOLD and the walk well below it,
+// the selectivity of spike_detector is close to spike_rate.
+struct SDWalkProcess
+{
+    struct State
+    {
+        float base;
+        float value;
+    };
+
+    float step;             // noise amplitude, relative to the base value
+    float reversion;        // pull towards the base value, per reading
+    float spike_size;
+    uint32_t spike_coin;    // spike_rate * 2^32
+
+    SDWalkProcess(const double spike_rate = 0.01,
+                  const double spike_size = 0.1,
+                  const double step = 0.002,
+                  const double reversion = 0.05)
+    : step(static_cast<float>(step))
+    , reversion(static_cast<float>(reversion))
+    , spike_size(static_cast<float>(spike_size))
+    , spike_coin(static_cast<uint32_t>(std::min(spike_rate, 1.0) * 4294967295.0))
+    {}
+
+    // bases in [15, 35), as the temperatures of the dataset
+    void init(State & s,
+              const uint32_t key,
+              uint64_t & rng) const
+    {
+        (void)key;
+        s.base = 15.0f + 20.0f * static_cast<float>(f_rand_next(rng) >> 40) / 16777216.0f;
+        s.value = s.base;
+    }
+
+    // one random word: the high half is the noise, the low half the spike coin
+    ALWAYS_INLINE void next(input_t & t,
+                            State & s,
+                            uint64_t & rng) const
+    {
+        const uint64_t r = f_rand_next(rng);
+        const float noise = static_cast<float>(static_cast<int32_t>(r >> 32)) * (1.0f / 2147483648.0f);
+        s.value += s.base * step * noise + reversion * (s.base - s.value);
+        const bool spike = (static_cast<uint32_t>(r) < spike_coin);
+        t.property_value = spike ? s.value * (1.0f + spike_size) : s.value;
+    }
+};
+
+// workload:KEYS,S[,SPIKE_RATE[,SPIKE_SIZE[,STEP]]]
+inline std::unique_ptr< FInput<input_t> > get_workload(const FInputSpec & spec,
+                                                      const size_t replicas)
+{
+    const std::vector<double> & p = spec.params;
+    const SDWalkProcess process(p.size() > 0 ? p[0] : 0.01,
+                                p.size() > 1 ? p[1] : 0.1,
+                                p.size() > 2 ? p[2] : 0.002);
+    return std::unique_ptr< FInput<input_t> >(new FWorkloadInput<input_t, SDWalkProcess>(FKeyDistribution(spec.keys, spec.s),
+                                                                                        process,
+                                                                                        replicas));
+}
@@ -2,29 +2,38 @@
 #include "common/input_t.hpp"
 #include "common/tuple_t.hpp"
 
+// Circular window with a running sum: one add and one subtract per value.
+// `fresh` sums the values written since the window last wrapped and replaces
+// the running sum at the wrap, which bounds its float drift.
 template <typename T, int SIZE>
 struct window_t
 {
     T win[SIZE];
+    T sum;
+    T fresh;
+    unsigned int head;
 
     window_t()
     : win{}
-    {
-    #pragma HLS array_partition variable=win complete dim=1
-    }
+    , sum(0)
+    , fresh(0)
+    , head(0)
+    {}
 
     T update(T val)
     {
     #pragma HLS INLINE
-    T sum = 0;
-    WIN_SHIFT:
-        for (int i = 0; i < SIZE - 1; ++i) {
-        #pragma HLS unroll
-            win[i] = win[i + 1];
-            sum += win[i];
+        const T old = win[head];
+        win[head] = val;
+        sum += val - old;
+        fresh += val;
+        if (head == SIZE - 1) {
+            head = 0;
+            sum = fresh;
+            fresh = 0;
+        } else {
+            head++;
         }
-        win[SIZE - 1] = val;
-        sum += val;
         return sum;
     }
 };
@@ -23,11 +23,6 @@ pthread_barrier_t barrier_setup;        // synchronize the setup of the threads
 pthread_barrier_t barrier_start;        // synchronize the start of the computation
 pthread_barrier_t barrier_end;          // synchronize the end of the computation
 
-std::atomic<size_t> tuples_sent;        // tuples sent by the StreamGenerator threads
-std::atomic<size_t> tuples_received;    // tuples received by the StreamDrainer threads
-std::atomic<size_t> batches_sent;       // batches sent by the StreamGenerator threads
-std::atomic<size_t> batches_received;   // batches received by the StreamDrainer threads
-
 
 int main(int argc, char** argv) {
 
@@ -78,10 +73,8 @@ int main(int argc, char** argv) {
     pthread_barrier_init(&barrier_setup, nullptr, generator_num_threads + drainer_num_threads + 1); // +1 for main thread
     pthread_barrier_init(&barrier_start, nullptr, generator_num_threads + drainer_num_threads + 1); // +1 for main thread
     pthread_barrier_init(&barrier_end,   nullptr, generator_num_threads + drainer_num_threads + 1); // +1 for main thread
-    tuples_sent = 0;
-    batches_sent = 0;
-    tuples_received = 0;
-    batches_received = 0;
+    Counters generator_counters(generator_num_threads);
+    Counters drainer_counters(drainer_num_threads);
 
 
     auto host_time_start = fx::high_resolution_time();
@@ -94,6 +87,7 @@ int main(int argc, char** argv) {
                 stream_generator_thread<input_t>,
                 i,
                 std::ref(ocl),
+                std::ref(generator_counters[i]),
                 std::ref(dataset),
                 generator_num_buffers,
                 generator_batch_size,
@@ -110,6 +104,7 @@ int main(int argc, char** argv) {
                 stream_drainer_thread<tuple_t>,
                 i,
                 std::ref(ocl),
+                std::ref(drainer_counters[i]),
                 drainer_num_buffers,
                 drainer_batch_size,
                 std::ref(app_start_time)
@@ -118,7 +113,7 @@ int main(int argc, char** argv) {
     }
 
     pthread_barrier_wait(&barrier_setup);
-    app_start_time = fx::current_time_nsecs();
+    app_start_time = monotonic_time_ns();
     auto time_start_compute = fx::high_resolution_time();
     pthread_barrier_wait(&barrier_start);
     pthread_barrier_wait(&barrier_end);
@@ -128,6 +123,10 @@ int main(int argc, char** argv) {
     for (auto& t : drainer_threads) t.join();
     auto host_time_end = fx::high_resolution_time();
 
+    const size_t tuples_sent      = generator_counters.tuples();
+    const size_t batches_sent     = generator_counters.batches();
+    const size_t tuples_received  = drainer_counters.tuples();
+    const size_t batches_received = drainer_counters.batches();
 
     auto elapsed_time_compute = fx::elapsed_time_ns(time_start_compute, time_end_compute);
     auto elapsed_time_host = fx::elapsed_time_ms(host_time_start, host_time_end);
@@ -148,9 +147,8 @@ int main(int argc, char** argv) {
 
     // dump benchmark results
     dump_benchmark(
-        "results.csv",
+        "results",
         bitstream,
-        {"MemoryReader", "AverageCalculator", "SpikeDetector", "MemoryWriter"},
         {generator_num_threads, generator_num_threads, generator_num_threads, drainer_num_threads},
         generator_num_buffers,
         generator_batch_size,
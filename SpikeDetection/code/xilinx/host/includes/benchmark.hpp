@@ -1,16 +1,20 @@
 #ifndef __BENCHMARK_HPP__
 #define __BENCHMARK_HPP__
 
-#include <fstream>
-#include <iostream>
 #include <string>
+#include <vector>
+#include <utility>
 
 #include "fspx_host.hpp"
+#include "../../common/constants.hpp"
+#include "report.hpp"
 
+// Appends one run to `<prefix>.jsonl` and `<prefix>.csv` with util::Report,
+// the schema of the Intel hosts read by the regression gate. Times and
+// latencies are in ns, bandwidths in B/s.
 void dump_benchmark(
-    std::string filename,
+    std::string prefix,
     std::string bitstream,
-    std::vector<std::string> operator_names,
     std::vector<size_t> operator_parallelisms,
     size_t mr_num_buffers,
     size_t mr_batch_size,
@@ -20,93 +24,62 @@ void dump_benchmark(
     size_t tuple_sent_size,
     size_t tuples_sent,
     size_t batches_sent,
-    size_t tuple_received_size, // unused
+    size_t tuple_received_size,
     size_t tuples_received,
     size_t batches_received,
     uint64_t elapsed_time_host,
     uint64_t elapsed_time_compute)
 {
-    (void)tuple_received_size;
+    (void)batches_sent;
+    (void)batches_received;
+    (void)elapsed_time_host;
 
-    size_t tuples_sec = tuples_sent / (elapsed_time_compute / 1e9);
-    size_t bytes_sec = tuples_sec * tuple_sent_size;
+    const double elapsed_time_s = elapsed_time_compute / 1e9;
+    const double throughput = tuples_sent / elapsed_time_s;
+    const double bandwidth_source = throughput * tuple_sent_size;
+    const double bandwidth_sink = (tuples_received * tuple_received_size) / elapsed_time_s;
 
-    bool print_header = false;
-    std::ifstream infile(filename);
-    if (!infile.good()) {
-        print_header = true;
+    std::string pars;
+    for (size_t i = 0; i < operator_parallelisms.size(); ++i) {
+        pars += (i ? "," : "") + std::to_string(operator_parallelisms[i]);
     }
-    infile.close();
 
-    std::ofstream outfile(filename, std::ios_base::app);
-    if (print_header) {
-        outfile << "Application" << ","
-                << "Bitstream" << ",";
-
-        for (auto name : operator_names) {
-            outfile << name << ",";
-        }
-
-        outfile << "MR Buffers" << ","
-                << "MW Buffers" << ","
-                << "MR BatchSize" << ","
-                << "MW BatchSize" << ","
-                << "Sampling" << ","
-                << "TupleSent" << ","
-                << "BatchesSent" << ","
-                << "TuplesReceived" << ","
-                << "BatchesReceived" << ","
-                << "Throughput (t/s)" << ","
-                << "Throughput (B/s)" << ","
-                << "Time (ms)" << ","
-                << "Time Compute (ns)" << ","
-                << "Samples" << ","
-                << "Total" << ","
-                << "Mean" << ","
-                << "0" << ","
-                << "5" << ","
-                << "25" << ","
-                << "50" << ","
-                << "75" << ","
-                << "95" << ","
-                << "100"
-                << std::endl;
-    }
+    util::Report report;
+    report.config("app",               "sd");
+#if MEASURE_LATENCY
+    report.config("benchmark",         "lat");
+#else
+    report.config("benchmark",         "thr");
+#endif
+    report.config("bitstream",         bitstream);
+    report.config("transfer",          "host");
+    report.config("pars",              pars);
+    report.config("source_buffers",    std::to_string(mr_num_buffers));
+    report.config("source_batch_size", std::to_string(mr_batch_size));
+    report.config("sink_buffers",      std::to_string(mw_num_buffers));
+    report.config("sink_batch_size",   std::to_string(mw_batch_size));
+    report.config("sampling_rate",     std::to_string(sampling_rate));
 
     auto latency_metric = fx::metric_group.get_metric("latency");
 
-    outfile << "SpikeDetection" << ","
-            << bitstream << ",";
-
-    for (auto par : operator_parallelisms) {
-        outfile << par << ",";
+    report.repetition();
+    report.add("time_ms",          elapsed_time_compute / 1e6);
+    report.add("throughput",       throughput);
+    report.add("source_bandwidth", bandwidth_source);
+    report.add("sink_bandwidth",   bandwidth_sink);
+    report.add("total_bandwidth",  bandwidth_source + bandwidth_sink);
+    report.add("drop_ratio",       1.0 - (tuples_received / double(tuples_sent)));
+    report.add("latency_samples",  latency_metric.getN());
+    if (latency_metric.getN() > 0) {
+        report.add("latency_mean", latency_metric.mean());
+        report.add("latency_p05",  latency_metric.percentile(0.05));
+        report.add("latency_p25",  latency_metric.percentile(0.25));
+        report.add("latency_p50",  latency_metric.percentile(0.5));
+        report.add("latency_p75",  latency_metric.percentile(0.75));
+        report.add("latency_p95",  latency_metric.percentile(0.95));
     }
 
-    outfile << mr_num_buffers << ","
-            << mw_num_buffers << ","
-            << mr_batch_size << ","
-            << mw_batch_size << ","
-            << sampling_rate << ","
-            << tuples_sent << ","
-            << batches_sent << ","
-            << tuples_received << ","
-            << batches_received << ","
-            << tuples_sec << ","
-            << bytes_sec << ","
-            << elapsed_time_host << ","
-            << elapsed_time_compute << ","
-            << latency_metric.getN() << ","
-            << latency_metric.total() << ","
-            << (uint64_t)(latency_metric.mean() / 1e3) << ","
-            << (uint64_t)(latency_metric.min() / 1e3) << ","
-            << (uint64_t)(latency_metric.percentile(0.05) / 1e3) << ","
-            << (uint64_t)(latency_metric.percentile(0.25) / 1e3) << ","
-            << (uint64_t)(latency_metric.percentile(0.5) / 1e3) << ","
-            << (uint64_t)(latency_metric.percentile(0.75) / 1e3) << ","
-            << (uint64_t)(latency_metric.percentile(0.95) / 1e3) << ","
-            << (uint64_t)(latency_metric.max() / 1e3)
-            << std::endl;
-    outfile.close();
+    report.write(prefix);
 }
 
-#endif // __BENCHMARK_HPP__
\ No newline at end of file
+#endif // __BENCHMARK_HPP__
@@ -0,0 +1,82 @@
+#ifndef __COUNTERS_HPP__
+#define __COUNTERS_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
+// Statistics of one generator or drainer thread. Only the owner thread
+// writes them (relaxed load and store, no locked read-modify-write) and each
+// block sits on its own cache line, so replicas never share a line.
+struct alignas(CACHE_LINE_SIZE) ReplicaCounters
+{
+    std::atomic<uint64_t> tuples;
+    std::atomic<uint64_t> batches;
+
+    ReplicaCounters()
+    : tuples(0)
+    , batches(0)
+    {}
+
+    inline void add(const uint64_t n)
+    {
+        tuples.store(tuples.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        batches.store(batches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+
+// One ReplicaCounters per thread, the totals sum the relaxed loads
+struct Counters
+{
+    size_t replicas;
+    ReplicaCounters * blocks;
+
+    Counters(const size_t replicas)
+    : replicas(replicas)
+    , blocks(nullptr)
+    {
+        void * ptr = nullptr;
+        if (posix_memalign(&ptr, CACHE_LINE_SIZE, (replicas ? replicas : 1) * sizeof(ReplicaCounters)) != 0) {
+            throw std::bad_alloc();
+        }
+        blocks = static_cast<ReplicaCounters *>(ptr);
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            new (blocks + rid) ReplicaCounters();
+        }
+    }
+
+    Counters(const Counters &) = delete;
+    Counters & operator=(const Counters &) = delete;
+
+    ~Counters()
+    {
+        for (size_t rid = 0; rid < replicas; ++rid) {
+            blocks[rid].~ReplicaCounters();
+        }
+        free(blocks);
+    }
+
+    ReplicaCounters & operator[](const size_t rid) { return blocks[rid]; }
+
+    uint64_t tuples() const
+    {
+        uint64_t total = 0;
+        for (size_t rid = 0; rid < replicas; ++rid) total += blocks[rid].tuples.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t batches() const
+    {
+        uint64_t total = 0;
+        for (size_t rid = 0; rid < replicas; ++rid) total += blocks[rid].batches.load(std::memory_order_relaxed);
+        return total;
+    }
+};
+
+#endif // __COUNTERS_HPP__
@@ -6,18 +6,17 @@
 #include <pthread.h>
 
 #include "fspx_host.hpp"
+#include "counters.hpp"
+#include "latency.hpp"
 
 extern pthread_barrier_t barrier_setup;
 extern pthread_barrier_t barrier_start;
 extern pthread_barrier_t barrier_end;
 
-extern std::atomic<size_t> tuples_sent;
-extern std::atomic<size_t> batches_sent;
-
 
 bool update_done(const uint64_t app_start_time,
                  const uint64_t app_run_time,
-                 const uint64_t current_time = fx::current_time_nsecs())
+                 const uint64_t current_time = monotonic_time_ns())
 {
     return ((current_time - app_start_time) > app_run_time);
 }
@@ -26,6 +25,7 @@ template <typename T>
 void stream_generator_thread(
     const size_t idx,
     fx::OCL & ocl,
+    ReplicaCounters & counters,
     const std::vector<T, fx::aligned_allocator<T> > & dataset,
     const size_t num_batches,
     const size_t batch_size,
@@ -34,8 +34,6 @@ void stream_generator_thread(
 )
 {
     std::vector<T, fx::aligned_allocator<T> > _dataset = dataset;
-    size_t _tuples_sent = 0;
-    size_t _batch_sent = 0;
 
     fx::StreamGenerator<T> stream_generator(ocl, batch_size, num_batches, idx);
 
@@ -47,9 +45,7 @@ void stream_generator_thread(
     while (!done) {
         T * batch = stream_generator.get_batch();
 
-        // generate a 32bit timestamp relative to app_start_time and convert it to 100ns
-        // this timestamp should be enough to store ~429 seconds
-        const uint32_t timestamp = static_cast<uint32_t>((fx::current_time_nsecs() - app_start_time) / uint64_t(100));
+        const latency_stamp_t timestamp = latency_stamp(app_start_time);
         for (size_t i = 0; i < batch_size; ++i) {
             T t = dataset[next_tuple_idx];
             #if MEASURE_LATENCY
@@ -61,14 +57,10 @@ void stream_generator_thread(
 
         done = update_done(app_start_time, app_run_time);
         stream_generator.push(batch, batch_size, done);
-        _tuples_sent += batch_size;
-        _batch_sent++;
+        counters.add(batch_size);
     }
     stream_generator.finish();
     pthread_barrier_wait(&barrier_end);
-
-    tuples_sent += _tuples_sent;
-    batches_sent += _batch_sent;
 }
 
 #endif // __STREAM_GENERATOR_THREAD_HPP__
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef __LATENCY_HPP__
+#define __LATENCY_HPP__
+
+#include <cstdint>
+#include <ctime>
+
+// End-to-end latency timestamps, with the same encoding as the Intel hosts.
+// The host clock is the 64-bit CLOCK_MONOTONIC in ns, a tuple carries the low
+// 32 bits of the ns elapsed since the start of the run and the latency is the
+// difference of two stamps modulo 2^32 (correct for any run length, as long
+// as a tuple spends less than ~4.29 s in the pipe).
+typedef uint32_t latency_stamp_t;
+
+inline uint64_t monotonic_time_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec) * uint64_t(1000000000) + t.tv_nsec;
+}
+
+inline latency_stamp_t latency_stamp(const uint64_t epoch_ns,
+                                     const uint64_t now_ns = monotonic_time_ns())
+{
+    return static_cast<latency_stamp_t>(now_ns - epoch_ns);
+}
+
+inline uint32_t latency_ns(const latency_stamp_t source_stamp,
+                           const latency_stamp_t sink_stamp)
+{
+    return static_cast<uint32_t>(sink_stamp - source_stamp);
+}
+
+#endif // __LATENCY_HPP__
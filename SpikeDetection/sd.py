@@ -11,16 +11,19 @@ par = 1                             # n. of replicas
 target_t = FTarget.XILINX           # XILINX or INTEL
 transfer_t = FTransferMode.HOST     # COPY, SHARED (Intel), or HOST (Xilinx)
 benchmark_t = 'throughput'          # throughput or latency
+instrument = False                  # device-side operator counters (Intel)
 
 win_dim = 16                                    # window size
-max_keys = 64                                   # max n. of keys in total
+max_keys = 64                                   # max n. of keys in total (up to tens of thousands per replica)
 avg_keys = next_power_of_two(max_keys // par)   # max n. of keys per replica
+cache_depth = 8                                 # updates in flight in average_calculator (Intel)
 threshold = 0.025                               # property threshold
 constants = {'MEASURE_LATENCY': 1 if benchmark_t == 'latency' else 0,
              'WIN_DIM': win_dim,
              'THRESHOLD': threshold,
              'MAX_KEYS': max_keys,
-             'AVG_KEYS': avg_keys}
+             'AVG_KEYS': avg_keys,
+             'CACHE_DEPTH': cache_depth}
 
 mr_node = FOperator('mr',
                     par,
@@ -48,13 +51,27 @@ mw_node = FOperator('mw',
                     FGatherPolicy.LB,
                     FDispatchPolicy.NONE)
 
-avg_node.add_private_buffer('int',
-                            'sizes',
-                            size=avg_keys,
-                            attributes='__attribute__((register))')
+# per-key state in on-chip memory with one read and one write port per bank;
+# updates in flight are forwarded by the cache, and a slot of a window is
+# read again only after win_dim updates of its key
+avg_node.add_local_buffer('average_t',
+                          'state',
+                          size=avg_keys,
+                          attributes='__attribute__((singlepump, numreadports(1), numwriteports(1)))',
+                          ivdep=cache_depth)
 avg_node.add_local_buffer('float',
                           'windows',
-                          size=(avg_keys, win_dim))
+                          size=(avg_keys, win_dim),
+                          attributes='__attribute__((singlepump, numreadports(1), numwriteports(1)))',
+                          ivdep=win_dim)
+avg_node.add_private_buffer('uint',
+                            'cache_keys',
+                            size=cache_depth,
+                            attributes='__attribute__((register))')
+avg_node.add_private_buffer('average_t',
+                            'cache_state',
+                            size=cache_depth,
+                            attributes='__attribute__((register))')
 
 codebase_t = './code/' + ('xilinx' if target_t == FTarget.XILINX else 'intel')
 transfer_char = ('s' if transfer_t == FTransferMode.SHARED else 'c' if transfer_t == FTransferMode.COPY else 'h')
@@ -65,7 +82,8 @@ pipe = FApplication('sd' + benchmark_char + transfer_char,
                     target = target_t,
                     constants=constants,
                     transfer_mode=transfer_t,
-                    codebase=codebase_t)
+                    codebase=codebase_t,
+                    instrument=instrument)
 pipe.add(mr_node)
 pipe.add(avg_node)
 pipe.add(spike_node)